@@ -0,0 +1,58 @@
+// Tokenizes and parses 1M command strings with
+// OptionParser::parse_command_line.
+
+#include <chrono>
+#include <iostream>
+
+#include "optionparser.h"
+
+int main() {
+  const std::size_t count = 1000000;
+  std::vector<std::string> commands;
+  commands.reserve(count);
+  std::size_t bytes = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    commands.push_back("run --threads " + std::to_string(i % 64) +
+                       " --name \"job " + std::to_string(i) +
+                       "\" --tag 'a b c' -v input\\ " + std::to_string(i));
+    bytes += commands.back().size();
+  }
+
+  std::size_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  std::string buffer;
+  std::vector<const char *> tokens;
+  for (const auto &command : commands) {
+    buffer = command;
+    optionparser::utils::tokenize_command_line(buffer, tokens);
+    sink += tokens.size();
+  }
+  std::chrono::duration<double> tokenize =
+      std::chrono::steady_clock::now() - start;
+
+  optionparser::OptionParser p("", false);
+  p.throw_on_failure();
+  p.add_option("--threads").mode(optionparser::StorageMode::STORE_VALUE);
+  p.add_option("--name").mode(optionparser::StorageMode::STORE_VALUE);
+  p.add_option("--tag").mode(optionparser::StorageMode::STORE_VALUE);
+  p.add_option("--verbose", "-v");
+  p.add_option("--help");
+  p.add_option("input");
+
+  start = std::chrono::steady_clock::now();
+  for (const auto &command : commands) {
+    p.parse_command_line(command);
+    sink += p.get_value<std::string>("name").size();
+  }
+  std::chrono::duration<double> parse =
+      std::chrono::steady_clock::now() - start;
+
+  auto mb = bytes / 1e6;
+  std::cout << count << " command strings, " << mb << " MB (" << sink
+            << ")\n"
+            << "  tokenize_command_line: " << tokenize.count() << " s, "
+            << mb / tokenize.count() << " MB/s\n"
+            << "  parse_command_line:    " << parse.count() << " s, "
+            << count / parse.count() << " commands/s\n";
+  return 0;
+}
@@ -0,0 +1,54 @@
+#!/usr/bin/env bash
+# Compare the compile time of a TU registering 50 options when it uses
+# `import optionparser;` against one that uses `#include "optionparser.h"`.
+#
+# usage: benchmarks/compile_time.sh [compiler] [runs]
+#
+# Only GCC's -fmodules-ts flag spelling is handled here; the module is
+# compiled once up front, as a build system would do.
+
+set -euo pipefail
+
+CXX=${1:-g++}
+RUNS=${2:-5}
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+WORK=$(mktemp -d)
+trap 'rm -rf "${WORK}"' EXIT
+cd "${WORK}"
+
+body() {
+  echo "int main(int argc, char const *argv[]) {"
+  echo "  optionparser::OptionParser p;"
+  for i in $(seq 1 50); do
+    echo "  p.add_option(\"--option${i}\").mode(optionparser::STORE_VALUE).help(\"option ${i}\");"
+  done
+  echo "  p.eat_arguments(argc, argv);"
+  echo "  return 0;"
+  echo "}"
+}
+
+{ echo "import optionparser;"; body; } > import.cc
+{ echo "#include \"optionparser.h\""; body; } > include.cc
+
+"${CXX}" -std=c++20 -fmodules-ts -I"${ROOT}/include" -c -x c++ \
+  "${ROOT}/modules/optionparser.cppm" -o module.o
+
+time_it() {
+  local start end
+  start=$(date +%s%N)
+  "$@"
+  end=$(date +%s%N)
+  echo $(((end - start) / 1000000))
+}
+
+total_import=0
+total_include=0
+for _ in $(seq 1 "${RUNS}"); do
+  t=$(time_it "${CXX}" -std=c++20 -fmodules-ts -c import.cc -o import.o)
+  total_import=$((total_import + t))
+  t=$(time_it "${CXX}" -std=c++20 -I"${ROOT}/include" -c include.cc -o include.o)
+  total_include=$((total_include + t))
+done
+
+echo "import optionparser;        $((total_import / RUNS)) ms/TU"
+echo "#include \"optionparser.h\"   $((total_include / RUNS)) ms/TU"
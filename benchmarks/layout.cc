@@ -0,0 +1,102 @@
+// Lays out a 100 KB help string with utils::stitch_str / utils::split_str
+// and with the quadratic implementation they replaced.
+
+#include <chrono>
+#include <iostream>
+
+#include "optionparser.h"
+
+namespace legacy {
+
+std::vector<std::string> split_str(std::string s,
+                                   const std::string &delimiter = " ") {
+  size_t pos = 0;
+  size_t delimiter_length = delimiter.length();
+  std::vector<std::string> vals;
+  while ((pos = s.find(delimiter)) != std::string::npos) {
+    vals.push_back(s.substr(0, pos));
+    s.erase(0, pos + delimiter_length);
+  }
+  vals.push_back(s);
+  return vals;
+}
+
+std::string stitch_str(const std::vector<std::string> &text,
+                       unsigned max_per_line = 80,
+                       const std::string &leading_str = "") {
+  std::vector<std::string> result;
+  std::string line_value;
+  for (const auto &token : text) {
+    if (line_value.empty()) {
+      line_value = (leading_str + token);
+      continue;
+    }
+    auto hypothetical_line = line_value;
+    hypothetical_line.append(" " + token);
+    if (hypothetical_line.size() > max_per_line) {
+      result.emplace_back(line_value);
+      line_value = (leading_str + token);
+    } else {
+      line_value = hypothetical_line;
+    }
+  }
+  result.emplace_back(line_value);
+  return std::accumulate(
+      result.begin() + 1, result.end(), result.at(0),
+      [](const std::string &s, const std::string &piece) -> std::string {
+        return s + "\n" + piece;
+      });
+}
+
+} // end namespace legacy
+
+template <class F> double time_ms(F f, int runs) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < runs; ++i) {
+    f();
+  }
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / runs;
+}
+
+int main() {
+  std::string text;
+  const char *words[] = {"option", "parser", "layout", "a", "wrapping",
+                         "benchmark", "of", "help", "text"};
+  for (std::size_t i = 0; text.size() < 100 * 1024; ++i) {
+    text += words[i % 9];
+    text += ' ';
+  }
+
+  std::size_t sink = 0;
+  auto current = time_ms(
+      [&]() {
+        sink += optionparser::utils::stitch_str(
+                    optionparser::utils::split_str(text), 75,
+                    std::string(25, ' '))
+                    .size();
+      },
+      20);
+  auto old = time_ms(
+      [&]() {
+        sink += legacy::stitch_str(legacy::split_str(text), 75,
+                                   std::string(25, ' '))
+                    .size();
+      },
+      3);
+  auto wrapper = time_ms(
+      [&]() {
+        std::string out;
+        optionparser::utils::TextWrapper w(out, 75, std::string(25, ' '));
+        w.words(text);
+        sink += out.size();
+      },
+      20);
+
+  std::cout << "100 KB help string (" << sink << ")\n"
+            << "  legacy split_str + stitch_str: " << old << " ms\n"
+            << "  split_str + stitch_str:        " << current << " ms\n"
+            << "  TextWrapper::words:            " << wrapper << " ms\n";
+  return 0;
+}
@@ -0,0 +1,50 @@
+// Decodes a list of 1M comma-separated IDs passed as --ids=..., once with
+// OptionParser::get_list and once the old way, utils::split_str followed by
+// std::stoi per element.
+
+#include <chrono>
+#include <iostream>
+
+#include "optionparser.h"
+
+int main() {
+  const std::size_t count = 1000000;
+  std::string argument = "--ids=";
+  for (std::size_t i = 0; i < count; ++i) {
+    argument += std::to_string(i * 7919 % 1000003) + ",";
+  }
+  argument.pop_back();
+
+  std::vector<const char *> argv = {"bench", argument.c_str()};
+  auto parse = [&argv](char separator) {
+    optionparser::OptionParser p("", false);
+    p.throw_on_failure();
+    p.add_option("--ids")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .separator(separator);
+    p.eat_arguments(argv.begin(), argv.end());
+    return p;
+  };
+
+  auto p = parse('\0');
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<int> split;
+  for (const auto &element :
+       optionparser::utils::split_str(p.get_value<std::string>("ids"), ",")) {
+    split.push_back(std::stoi(element));
+  }
+  std::chrono::duration<double> split_time =
+      std::chrono::steady_clock::now() - start;
+
+  p = parse(',');
+  start = std::chrono::steady_clock::now();
+  auto list = p.get_list<int>("ids");
+  std::chrono::duration<double> list_time =
+      std::chrono::steady_clock::now() - start;
+
+  std::cout << count << " list elements (" << (split == list) << ")\n"
+            << "  split_str + stoi: " << split_time.count() << " s\n"
+            << "  get_list<int>:    " << list_time.count() << " s\n";
+  return 0;
+}
@@ -0,0 +1,47 @@
+// Parses 1M argv vectors of short flags, once spelled out one flag per
+// argument ("-v -v -x -n 5") and once clustered ("-vvx -n5").
+
+#include <chrono>
+#include <iostream>
+
+#include "optionparser.h"
+
+static double run(optionparser::OptionParser &p,
+                  const std::vector<const char *> &argv, std::size_t count,
+                  std::size_t &sink) {
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < count; ++i) {
+    p.eat_arguments(argv.begin(), argv.end());
+    sink += p.get_value<std::string>("n_option").size();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+int main() {
+  const std::size_t count = 1000000;
+  optionparser::OptionParser p("", false);
+  p.throw_on_failure();
+  p.add_option("-v");
+  p.add_option("-x");
+  p.add_option("-z");
+  p.add_option("-f");
+  p.add_option("-n").mode(optionparser::StorageMode::STORE_VALUE);
+  p.add_option("input");
+
+  std::vector<const char *> separate = {"bench", "-v", "-x", "-z", "-f",
+                                        "-n",    "5",  "input"};
+  std::vector<const char *> clustered = {"bench", "-vxzf", "-n5", "input"};
+
+  std::size_t sink = 0;
+  auto unclustered_time = run(p, separate, count, sink);
+  auto clustered_time = run(p, clustered, count, sink);
+
+  std::cout << count << " argv vectors (" << sink << ")\n"
+            << "  unclustered: " << unclustered_time << " s, "
+            << count / unclustered_time << " argv/s\n"
+            << "  clustered:   " << clustered_time << " s, "
+            << count / clustered_time << " argv/s\n";
+  return 0;
+}
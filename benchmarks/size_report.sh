@@ -0,0 +1,49 @@
+#!/usr/bin/env bash
+# Report the text/data/bss savings of building with OPTIONPARSER_NO_HELP,
+# for a program registering 50 options, along with sizeof(Option).
+#
+# usage: benchmarks/size_report.sh [compiler] [flags...]
+
+set -euo pipefail
+
+CXX=${1:-g++}
+shift || true
+FLAGS=${*:--Os}
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+WORK=$(mktemp -d)
+trap 'rm -rf "${WORK}"' EXIT
+cd "${WORK}"
+
+{
+  echo "#include \"optionparser.h\""
+  echo "int main(int argc, char const *argv[]) {"
+  echo "  optionparser::OptionParser p(\"A program with 50 options.\");"
+  for i in $(seq 1 50); do
+    echo "  p.add_option(\"--option${i}\").mode(optionparser::STORE_VALUE)"
+    echo "      .help(\"Help text for option ${i}, long enough to be realistic.\");"
+  done
+  echo "  p.eat_arguments(argc, argv);"
+  echo "  return 0;"
+  echo "}"
+} > main.cc
+
+{
+  echo "#include <cstdio>"
+  echo "#include \"optionparser.h\""
+  echo "int main() { std::printf(\"%zu\\n\", sizeof(optionparser::Option)); }"
+} > sizeof.cc
+
+for variant in full nohelp; do
+  defs=""
+  if [ "${variant}" = nohelp ]; then
+    defs="-DOPTIONPARSER_NO_HELP"
+  fi
+  # shellcheck disable=SC2086
+  "${CXX}" -std=c++11 ${FLAGS} ${defs} -I"${ROOT}/include" main.cc -o "${variant}"
+  # shellcheck disable=SC2086
+  "${CXX}" -std=c++11 ${defs} -I"${ROOT}/include" sizeof.cc -o "sizeof-${variant}"
+  strip "${variant}"
+  read -r text data bss _ < <(size "${variant}" | tail -n 1)
+  printf "%-7s text %8d  data %6d  bss %6d  sizeof(Option) %4s\n" \
+    "${variant}" "${text}" "${data}" "${bss}" "$("./sizeof-${variant}")"
+done
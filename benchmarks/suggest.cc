@@ -0,0 +1,31 @@
+// Times OptionParser::suggest, the "did you mean" hint of unrecognized
+// arguments, against a schema of 1500 long flags.
+
+#include <chrono>
+#include <iostream>
+
+#include "optionparser.h"
+
+int main() {
+  const std::size_t flags = 1500;
+  const std::size_t lookups = 1000;
+  optionparser::OptionParser p("", false);
+  p.throw_on_failure();
+  for (std::size_t i = 0; i < flags; ++i) {
+    p.add_option("--tuning-parameter-" + std::to_string(i));
+  }
+
+  std::size_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < lookups; ++i) {
+    sink += p.suggest("--tunning-paramter-" + std::to_string(i)).size();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  std::cout << lookups << " suggestions against " << flags << " flags ("
+            << sink << ")\n"
+            << "  suggest: " << elapsed.count() * 1e6 / lookups
+            << " us per unrecognized argument\n";
+  return 0;
+}
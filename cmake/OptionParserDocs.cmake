@@ -0,0 +1,74 @@
+# optionparser_generate_docs(<target>
+#                            SCHEMA <file>
+#                            [PROG <name>]
+#                            [NAMESPACE <namespace>]
+#                            [OUTPUT_DIR <dir>])
+#
+# Renders the help text, a man page and Markdown documentation for <target>
+# at build time and compiles them into it as static data.
+#
+# SCHEMA names a file defining
+#
+#   optionparser::OptionParser optionparser_schema();
+#
+# that registers all of the program's options. It is #included by a
+# generator executable (<target>-docgen) which is built and run on the host,
+# so it is typically the header the program itself uses to build its parser.
+#
+# The generated `<NAMESPACE>.h` (default: `<target>_docs`) declares
+# `help_text`, `man_page` and `markdown` character arrays in namespace
+# <NAMESPACE>. Hand `help_text` to OptionParser::precomputed_help() so that
+# `--help` prints it without laying anything out. `<PROG>.txt`, `<PROG>.1`
+# and `<PROG>.md` are written to OUTPUT_DIR as well, for installation, along
+# with shell completion scripts: `<PROG>.bash`, `_<PROG>` (zsh) and
+# `<PROG>.fish`. The layout never depends on the terminal the build happens
+# to run in.
+
+set(_OPTIONPARSER_CMAKE_DIR ${CMAKE_CURRENT_LIST_DIR} CACHE INTERNAL "")
+
+function(optionparser_generate_docs target)
+    cmake_parse_arguments(ARG "" "SCHEMA;PROG;NAMESPACE;OUTPUT_DIR" "" ${ARGN})
+
+    if(NOT ARG_SCHEMA)
+        message(FATAL_ERROR "optionparser_generate_docs: SCHEMA is required")
+    endif()
+    if(NOT ARG_PROG)
+        set(ARG_PROG ${target})
+    endif()
+    if(NOT ARG_NAMESPACE)
+        string(MAKE_C_IDENTIFIER "${target}_docs" ARG_NAMESPACE)
+    endif()
+    if(NOT ARG_OUTPUT_DIR)
+        set(ARG_OUTPUT_DIR ${CMAKE_CURRENT_BINARY_DIR}/${target}_docs)
+    endif()
+    get_filename_component(schema ${ARG_SCHEMA} ABSOLUTE)
+
+    set(generator ${target}-docgen)
+    add_executable(${generator} ${_OPTIONPARSER_CMAKE_DIR}/optionparser_docgen.cc)
+    target_compile_features(${generator} PRIVATE cxx_std_11)
+    target_compile_definitions(${generator} PRIVATE OPTIONPARSER_SCHEMA_SOURCE="${schema}")
+    target_link_libraries(${generator} PRIVATE optionparser::optionparser)
+
+    set(outputs
+            ${ARG_OUTPUT_DIR}/${ARG_NAMESPACE}.h
+            ${ARG_OUTPUT_DIR}/${ARG_NAMESPACE}.cc
+            ${ARG_OUTPUT_DIR}/${ARG_PROG}.txt
+            ${ARG_OUTPUT_DIR}/${ARG_PROG}.1
+            ${ARG_OUTPUT_DIR}/${ARG_PROG}.md
+            ${ARG_OUTPUT_DIR}/${ARG_PROG}.bash
+            ${ARG_OUTPUT_DIR}/_${ARG_PROG}
+            ${ARG_OUTPUT_DIR}/${ARG_PROG}.fish)
+    add_custom_command(
+            OUTPUT ${outputs}
+            COMMAND ${CMAKE_COMMAND} -E make_directory ${ARG_OUTPUT_DIR}
+            COMMAND ${CMAKE_COMMAND} -E env COLUMNS=0
+                    $<TARGET_FILE:${generator}> ${ARG_PROG} ${ARG_NAMESPACE} ${ARG_OUTPUT_DIR}
+            DEPENDS ${generator} ${schema}
+            COMMENT "Generating documentation for ${target}"
+            VERBATIM)
+
+    target_sources(${target} PRIVATE
+            ${ARG_OUTPUT_DIR}/${ARG_NAMESPACE}.h
+            ${ARG_OUTPUT_DIR}/${ARG_NAMESPACE}.cc)
+    target_include_directories(${target} PRIVATE ${ARG_OUTPUT_DIR})
+endfunction()
@@ -0,0 +1,102 @@
+//-----------------------------------------------------------------------------
+//  optionparser_docgen.cc -- Build-time help/man/Markdown/completion generator
+//  Author: Luke de Oliveira <lukedeo@ldo.io>
+//  License: MIT
+//-----------------------------------------------------------------------------
+//
+// Built and run by optionparser_generate_docs() (see OptionParserDocs.cmake).
+// OPTIONPARSER_SCHEMA_SOURCE names a file defining
+//
+//   optionparser::OptionParser optionparser_schema();
+//
+// which is included here rather than compiled separately because
+// optionparser.h may only be included by a single translation unit.
+//
+// usage: optionparser_docgen <prog> <namespace> <output dir>
+
+#include <fstream>
+
+// The generator always needs the help machinery, even when the programs it
+// documents are built without it.
+#undef OPTIONPARSER_NO_HELP
+#include "optionparser.h"
+
+#include OPTIONPARSER_SCHEMA_SOURCE
+
+namespace {
+
+void write_file(const std::string &path, const std::string &contents) {
+  std::ofstream out(path, std::ios::binary);
+  out << contents;
+  if (!out) {
+    throw std::runtime_error("could not write '" + path + "'");
+  }
+}
+
+// Render `text` as a sequence of adjacent string literals, one per line, to
+// stay clear of compiler limits on the length of a single literal.
+std::string to_literal(const std::string &text) {
+  static const char digits[] = "01234567";
+  std::string literal = "\"";
+  for (unsigned char c : text) {
+    if (c == '"' || c == '\\') {
+      literal += '\\';
+      literal += static_cast<char>(c);
+    } else if (c == '\n') {
+      literal += "\\n\"\n    \"";
+    } else if (c < 0x20 || c >= 0x7F) {
+      literal += '\\';
+      literal += digits[(c >> 6) & 7];
+      literal += digits[(c >> 3) & 7];
+      literal += digits[c & 7];
+    } else {
+      literal += static_cast<char>(c);
+    }
+  }
+  return literal + "\"";
+}
+
+} // end namespace
+
+int main(int argc, char const *argv[]) {
+  if (argc != 4) {
+    std::cerr << "usage: " << argv[0] << " <prog> <namespace> <output dir>"
+              << std::endl;
+    return 1;
+  }
+  const std::string prog = argv[1];
+  const std::string ns = argv[2];
+  const std::string dir = argv[3];
+
+  auto parser = optionparser_schema();
+  parser.prog_name(prog);
+
+  const std::string help = parser.help_text();
+  const std::string man = parser.man_page();
+  const std::string md = parser.markdown();
+
+  write_file(dir + "/" + prog + ".txt", help);
+  write_file(dir + "/" + prog + ".1", man);
+  write_file(dir + "/" + prog + ".md", md);
+  write_file(dir + "/" + prog + ".bash", parser.completion_script("bash"));
+  write_file(dir + "/_" + prog, parser.completion_script("zsh"));
+  write_file(dir + "/" + prog + ".fish", parser.completion_script("fish"));
+
+  write_file(dir + "/" + ns + ".h",
+             "// Generated by optionparser_docgen, do not edit.\n"
+             "#pragma once\n\n"
+             "namespace " + ns + " {\n\n"
+             "extern const char help_text[];\n"
+             "extern const char man_page[];\n"
+             "extern const char markdown[];\n\n"
+             "} // end namespace " + ns + "\n");
+  write_file(dir + "/" + ns + ".cc",
+             "// Generated by optionparser_docgen, do not edit.\n"
+             "#include \"" + ns + ".h\"\n\n"
+             "namespace " + ns + " {\n\n"
+             "const char help_text[] =\n    " + to_literal(help) + ";\n\n"
+             "const char man_page[] =\n    " + to_literal(man) + ";\n\n"
+             "const char markdown[] =\n    " + to_literal(md) + ";\n\n"
+             "} // end namespace " + ns + "\n");
+  return 0;
+}
@@ -7,64 +7,790 @@
 #ifndef OPTIONPARSER_H_
 #define OPTIONPARSER_H_
 
+// Define OPTIONPARSER_NO_HELP (or configure with -DOPTIONPARSER_NO_HELP=ON) to
+// compile out help strings, metavars and all help rendering. Option::help(),
+// Option::metavar() and the descriptions of parsers and subcommands are
+// still accepted but discarded, and help() only prints the text handed to
+// OptionParser::precomputed_help(); without it, `--help` is an error.
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <numeric>
 #include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#if defined(__unix__) || defined(__APPLE__)
+#if !defined(OPTIONPARSER_NO_HELP)
+#include <sys/ioctl.h>
+#endif
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace optionparser {
 
 // The utils::* namespace contains general utilities not necessarily useful
 // outside the main scope of the library
 namespace utils {
 
-std::vector<std::string> split_str(std::string s,
+#ifndef OPTIONPARSER_NO_HELP
+
+// Number of bytes in the UTF-8 sequence introduced by `lead`.
+std::size_t utf8_length(unsigned char lead) {
+  if (lead < 0xC0) {
+    return 1;
+  }
+  if (lead < 0xE0) {
+    return 2;
+  }
+  return lead < 0xF0 ? 3 : 4;
+}
+
+// Terminal columns taken by a code point: zero for combining marks, two for
+// East Asian wide/fullwidth characters and emoji, one otherwise.
+std::size_t codepoint_width(unsigned long cp) {
+  if ((cp >= 0x0300 && cp <= 0x036F) || (cp >= 0x200B && cp <= 0x200F) ||
+      (cp >= 0xFE20 && cp <= 0xFE2F)) {
+    return 0;
+  }
+  if ((cp >= 0x1100 && cp <= 0x115F) || (cp >= 0x2E80 && cp <= 0xA4CF) ||
+      (cp >= 0xAC00 && cp <= 0xD7A3) || (cp >= 0xF900 && cp <= 0xFAFF) ||
+      (cp >= 0xFE30 && cp <= 0xFE4F) || (cp >= 0xFF00 && cp <= 0xFF60) ||
+      (cp >= 0xFFE0 && cp <= 0xFFE6) || (cp >= 0x1F300 && cp <= 0x1F64F) ||
+      (cp >= 0x1F900 && cp <= 0x1F9FF) || (cp >= 0x20000 && cp <= 0x3FFFD)) {
+    return 2;
+  }
+  return 1;
+}
+
+// Display width of the UTF-8 text in [first, last). Plain ASCII costs one
+// comparison per byte.
+std::size_t display_width(const char *first, const char *last) {
+  std::size_t width = 0;
+  while (first < last) {
+    auto lead = static_cast<unsigned char>(*first);
+    if (lead < 0x80) {
+      ++width;
+      ++first;
+      continue;
+    }
+    auto length = utf8_length(lead);
+    if (static_cast<std::size_t>(last - first) < length) {
+      // Truncated sequence, count what is left as a single column.
+      return width + 1;
+    }
+    unsigned long cp = lead & (0xFF >> (length + 1));
+    for (std::size_t i = 1; i < length; ++i) {
+      cp = (cp << 6) | (static_cast<unsigned char>(first[i]) & 0x3F);
+    }
+    width += length == 1 ? 1 : codepoint_width(cp);
+    first += length;
+  }
+  return width;
+}
+
+std::size_t display_width(const std::string &s) {
+  return display_width(s.data(), s.data() + s.size());
+}
+
+// Width of the terminal attached to stdout, or zero when there is none. It
+// is only queried once per process. Setting COLUMNS overrides the query, and
+// COLUMNS=0 disables it.
+std::size_t terminal_width() {
+  static const std::size_t width = []() -> std::size_t {
+    if (const char *columns = std::getenv("COLUMNS")) {
+      return std::strtoul(columns, nullptr, 10);
+    }
+#if defined(__unix__) || defined(__APPLE__)
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) {
+      return ws.ws_col;
+    }
+#endif
+    return 0;
+  }();
+  return width;
+}
+
+// Line width to lay text out at: `preferred`, narrowed to fit the terminal
+// when there is one, but never below `minimum`.
+std::size_t layout_width(std::size_t preferred, std::size_t minimum) {
+  auto columns = terminal_width();
+  if (columns == 0) {
+    return preferred;
+  }
+  return std::min(preferred, std::max(columns, minimum));
+}
+
+// Greedy word wrapper that appends to an output buffer as words come in, so
+// laying out n bytes of text costs O(n). Words are joined by single spaces
+// and a line is broken before a word that would take it past `width`
+// display columns. Continuation lines start with `indent`; the first line
+// continues the one the caller has already started at `first_column`.
+class TextWrapper {
+public:
+  TextWrapper(std::string &out, std::size_t width, std::string indent,
+              std::size_t first_column = 0)
+      : m_out(out), m_width(width), m_indent(std::move(indent)),
+        m_indent_width(display_width(m_indent)), m_column(first_column) {}
+
+  void word(const char *first, const char *last) {
+    auto width = display_width(first, last);
+    if (m_first_word) {
+      m_first_word = false;
+      m_column += width;
+    } else if (m_column + 1 + width > m_width) {
+      m_out += '\n';
+      m_out += m_indent;
+      m_column = m_indent_width + width;
+    } else {
+      m_out += ' ';
+      m_column += 1 + width;
+    }
+    m_out.append(first, last);
+  }
+
+  void word(const std::string &w) { word(w.data(), w.data() + w.size()); }
+
+  // Feeds every `delimiter`-separated word of [first, last), empty ones
+  // included, in a single pass over the text.
+  void words(const char *first, const char *last, char delimiter = ' ') {
+    while (true) {
+      auto end = std::find(first, last, delimiter);
+      word(first, end);
+      if (end == last) {
+        return;
+      }
+      first = end + 1;
+    }
+  }
+
+  void words(const std::string &text, char delimiter = ' ') {
+    words(text.data(), text.data() + text.size(), delimiter);
+  }
+
+private:
+  std::string &m_out;
+  std::size_t m_width;
+  std::string m_indent;
+  std::size_t m_indent_width;
+  std::size_t m_column;
+  bool m_first_word = true;
+};
+
+#endif // OPTIONPARSER_NO_HELP
+
+std::vector<std::string> split_str(const std::string &s,
                                    const std::string &delimiter = " ") {
-  size_t pos = 0;
-  size_t delimiter_length = delimiter.length();
   std::vector<std::string> vals;
-  while ((pos = s.find(delimiter)) != std::string::npos) {
-    vals.push_back(s.substr(0, pos));
-    s.erase(0, pos + delimiter_length);
+  std::size_t start = 0;
+  std::size_t pos;
+  while ((pos = s.find(delimiter, start)) != std::string::npos) {
+    vals.emplace_back(s, start, pos - start);
+    start = pos + delimiter.length();
   }
-  vals.push_back(s);
+  vals.emplace_back(s, start, std::string::npos);
   return vals;
 }
 
+// Splits a command line the way a POSIX shell would, minus expansions:
+// words are separated by unquoted blanks, single quotes preserve everything
+// up to the closing quote, double quotes preserve everything but `\\` before
+// one of `$`, `\``, `"`, `\\` or a newline, and an unquoted `\\` escapes the
+// next character (and removes an escaped newline altogether).
+//
+// The words are unescaped in place: `buffer` ends up holding them
+// NUL-terminated back to back and `tokens` receives a pointer to each, so
+// one pass over the input does all the work. Plain runs are copied in bulk,
+// finding the closing quote uses memchr. Returns nullptr on success and a
+// description of the problem otherwise.
+const char *tokenize_command_line(std::string &buffer,
+                                  std::vector<const char *> &tokens) {
+  enum : unsigned char { PLAIN = 0, BLANK, SQUOTE, DQUOTE, ESCAPE };
+  static const struct CharClass {
+    unsigned char table[256];
+    CharClass() : table() {
+      table[static_cast<unsigned char>(' ')] = BLANK;
+      table[static_cast<unsigned char>('\t')] = BLANK;
+      table[static_cast<unsigned char>('\n')] = BLANK;
+      table[static_cast<unsigned char>('\'')] = SQUOTE;
+      table[static_cast<unsigned char>('"')] = DQUOTE;
+      table[static_cast<unsigned char>('\\')] = ESCAPE;
+    }
+  } classes;
+
+  // Room for the terminator of the last word, which never outgrows its input.
+  buffer.push_back('\0');
+  char *in = &buffer[0];
+  char *end = in + buffer.size() - 1;
+  char *out = in;
+  std::vector<std::size_t> starts;
+  bool in_word = false;
+
+  while (in < end) {
+    auto cls = classes.table[static_cast<unsigned char>(*in)];
+    if (cls == BLANK) {
+      if (in_word) {
+        *out++ = '\0';
+        in_word = false;
+      }
+      ++in;
+      continue;
+    }
+    if (!in_word) {
+      starts.push_back(out - &buffer[0]);
+      in_word = true;
+    }
+    if (cls == PLAIN) {
+      char *run = in + 1;
+      while (run < end && classes.table[static_cast<unsigned char>(*run)] ==
+                              PLAIN) {
+        ++run;
+      }
+      std::memmove(out, in, run - in);
+      out += run - in;
+      in = run;
+    } else if (cls == SQUOTE) {
+      auto close = static_cast<char *>(std::memchr(in + 1, '\'', end - in - 1));
+      if (!close) {
+        return "unterminated single quote";
+      }
+      std::memmove(out, in + 1, close - in - 1);
+      out += close - in - 1;
+      in = close + 1;
+    } else if (cls == DQUOTE) {
+      ++in;
+      while (true) {
+        if (in == end) {
+          return "unterminated double quote";
+        }
+        if (*in == '"') {
+          ++in;
+          break;
+        }
+        if (*in == '\\' && in + 1 < end &&
+            std::strchr("$`\"\\\n", in[1]) != nullptr) {
+          if (in[1] != '\n') {
+            *out++ = in[1];
+          }
+          in += 2;
+          continue;
+        }
+        *out++ = *in++;
+      }
+    } else {
+      if (in + 1 == end) {
+        return "trailing backslash";
+      }
+      if (in[1] != '\n') {
+        *out++ = in[1];
+      } else if (out == &buffer[0] + starts.back()) {
+        // A line continuation on its own does not start a word.
+        starts.pop_back();
+        in_word = false;
+      }
+      in += 2;
+    }
+  }
+  if (in_word) {
+    *out++ = '\0';
+  }
+
+  tokens.clear();
+  tokens.reserve(starts.size());
+  for (auto start : starts) {
+    tokens.push_back(&buffer[0] + start);
+  }
+  return nullptr;
+}
+
+// Levenshtein distance from a fixed pattern to any number of texts. For
+// patterns of up to 64 bytes this is Myers' bit-parallel algorithm in
+// Hyyrö's formulation: one column of the DP matrix is kept as two bit
+// vectors of +1/-1 vertical deltas, so every text byte costs a handful of
+// word operations. Longer patterns fall back to the textbook row-by-row DP.
+class EditDistance {
+public:
+  EditDistance(const char *first, const char *last)
+      : m_pattern(first, last), m_peq() {
+    if (m_pattern.size() <= 64) {
+      for (std::size_t i = 0; i < m_pattern.size(); ++i) {
+        m_peq[static_cast<unsigned char>(m_pattern[i])] |= 1ull << i;
+      }
+    }
+  }
+
+  explicit EditDistance(const std::string &pattern)
+      : EditDistance(pattern.data(), pattern.data() + pattern.size()) {}
+
+  std::size_t operator()(const char *first, const char *last) const {
+    auto m = m_pattern.size();
+    if (m == 0) {
+      return last - first;
+    }
+    if (m > 64) {
+      return slow(first, last);
+    }
+    const unsigned long long high = 1ull << (m - 1);
+    unsigned long long pv = ~0ull, mv = 0;
+    auto score = m;
+    for (; first != last; ++first) {
+      auto eq = m_peq[static_cast<unsigned char>(*first)];
+      auto xv = eq | mv;
+      auto xh = (((eq & pv) + pv) ^ pv) | eq;
+      auto ph = mv | ~(xh | pv);
+      auto mh = pv & xh;
+      if (ph & high) {
+        ++score;
+      } else if (mh & high) {
+        --score;
+      }
+      // The top row of the matrix grows by one per text byte.
+      ph = (ph << 1) | 1;
+      mh <<= 1;
+      pv = mh | ~(xv | ph);
+      mv = ph & xv;
+    }
+    return score;
+  }
+
+  std::size_t operator()(const std::string &text) const {
+    return (*this)(text.data(), text.data() + text.size());
+  }
+
+private:
+  std::size_t slow(const char *first, const char *last) const {
+    std::vector<std::size_t> row(m_pattern.size() + 1);
+    std::iota(row.begin(), row.end(), 0);
+    for (std::size_t j = 1; first != last; ++first, ++j) {
+      auto diagonal = row[0];
+      row[0] = j;
+      for (std::size_t i = 1; i < row.size(); ++i) {
+        auto up = row[i];
+        row[i] = std::min({up + 1, row[i - 1] + 1,
+                           diagonal + (m_pattern[i - 1] != *first)});
+        diagonal = up;
+      }
+    }
+    return row.back();
+  }
+
+  std::string m_pattern;
+  unsigned long long m_peq[256];
+};
+
+// Up to `count` of `candidates`, closest to `target` first.
+std::vector<std::string> nearest(const std::string &target,
+                                 const std::vector<std::string> &candidates,
+                                 std::size_t count) {
+  EditDistance distance(target);
+  std::vector<std::pair<std::size_t, std::size_t>> ranked;
+  ranked.reserve(candidates.size());
+  for (std::size_t i = 0; i < candidates.size(); ++i) {
+    ranked.emplace_back(distance(candidates[i]), i);
+  }
+  count = std::min(count, ranked.size());
+  std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end());
+  std::vector<std::string> closest;
+  for (std::size_t i = 0; i < count; ++i) {
+    closest.push_back(candidates[ranked[i].second]);
+  }
+  return closest;
+}
+
+// Decode one element of a delimited list, [first, last), which must be
+// followed by a non-digit (the separator or the terminating NUL). Return
+// false unless the whole element is a valid, in-range value. Numbers are
+// written plainly: no whitespace, no '+', and '-' only where a negative
+// value can be stored.
+inline bool plain_number(const char *first, const char *last, bool negative) {
+  if (first != last && negative && *first == '-') {
+    ++first;
+  }
+  return first != last &&
+         (std::isdigit(static_cast<unsigned char>(*first)) || *first == '.');
+}
+
+template <class T>
+typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value,
+                        bool>::type
+decode_element(const char *first, const char *last, T &out) {
+  if (!plain_number(first, last, true)) {
+    return false;
+  }
+  char *end;
+  errno = 0;
+  auto value = std::strtoll(first, &end, 10);
+  if (end != last || errno ||
+      value < std::numeric_limits<T>::min() ||
+      value > std::numeric_limits<T>::max()) {
+    return false;
+  }
+  out = static_cast<T>(value);
+  return true;
+}
+
+template <class T>
+typename std::enable_if<
+    std::is_integral<T>::value && !std::is_signed<T>::value, bool>::type
+decode_element(const char *first, const char *last, T &out) {
+  if (!plain_number(first, last, false)) {
+    return false;
+  }
+  char *end;
+  errno = 0;
+  auto value = std::strtoull(first, &end, 10);
+  if (end != last || errno ||
+      value > std::numeric_limits<T>::max()) {
+    return false;
+  }
+  out = static_cast<T>(value);
+  return true;
+}
+
+template <class T>
+typename std::enable_if<std::is_floating_point<T>::value, bool>::type
+decode_element(const char *first, const char *last, T &out) {
+  if (!plain_number(first, last, true)) {
+    return false;
+  }
+  char *end;
+  errno = 0;
+  auto value = std::strtod(first, &end);
+  if (end != last || errno == ERANGE) {
+    return false;
+  }
+  out = static_cast<T>(value);
+  return true;
+}
+
+inline bool decode_element(const char *first, const char *last,
+                           std::string &out) {
+  out.assign(first, last);
+  return true;
+}
+
+// Whether a number stored as the widest type of its kind converts to T
+// without leaving T's range.
+template <class T>
+typename std::enable_if<std::is_integral<T>::value, bool>::type
+in_range(long long value) {
+  if (value < 0) {
+    return std::is_signed<T>::value &&
+           value >= static_cast<long long>(std::numeric_limits<T>::min());
+  }
+  return static_cast<unsigned long long>(value) <=
+         static_cast<unsigned long long>(std::numeric_limits<T>::max());
+}
+
+template <class T>
+typename std::enable_if<std::is_integral<T>::value, bool>::type
+in_range(unsigned long long value) {
+  return value <=
+         static_cast<unsigned long long>(std::numeric_limits<T>::max());
+}
+
+// Fractions are dropped, so the bounds are one past T's. NaN is out of range.
+template <class T>
+typename std::enable_if<std::is_integral<T>::value, bool>::type
+in_range(double value) {
+  return value > static_cast<double>(std::numeric_limits<T>::min()) - 1 &&
+         value < static_cast<double>(std::numeric_limits<T>::max()) + 1;
+}
+
+// Infinities and NaN stay what they are.
+template <class T>
+typename std::enable_if<std::is_floating_point<T>::value, bool>::type
+in_range(double value) {
+  return !std::isfinite(value) ||
+         std::fabs(value) <= std::numeric_limits<T>::max();
+}
+
+template <class T, class N>
+typename std::enable_if<std::is_floating_point<T>::value &&
+                            std::is_integral<N>::value,
+                        bool>::type
+in_range(N) {
+  return true;
+}
+
+// Copy a string-like argument into `out`, reusing its storage: through
+// data() and size() where the type has them (string views and the like),
+// otherwise through its conversion to std::string. Call with a 0 last.
+template <class T>
+auto assign_str(std::string &out, const T &text, int)
+    -> decltype(out.assign(text.data(), text.size()), void()) {
+  out.assign(text.data(), text.size());
+}
+
+template <class T> void assign_str(std::string &out, const T &text, long) {
+  out = std::string(text);
+}
+
+// A fixed-size set of bits, with the few whole-word operations needed to
+// check constraints between options.
+class Bitset {
+public:
+  explicit Bitset(std::size_t size = 0) : m_words((size + 63) / 64) {}
+
+  void set(std::size_t bit) { m_words[bit / 64] |= 1ull << (bit % 64); }
+  bool test(std::size_t bit) const {
+    return (m_words[bit / 64] >> (bit % 64)) & 1;
+  }
+
+  // Number of bits set in both sets.
+  std::size_t count_common(const Bitset &other) const {
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < m_words.size(); ++i) {
+      count += popcount(m_words[i] & other.m_words[i]);
+    }
+    return count;
+  }
+
+  // Whether every bit set in `other` is set here too.
+  bool contains(const Bitset &other) const {
+    for (std::size_t i = 0; i < m_words.size(); ++i) {
+      if (other.m_words[i] & ~m_words[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  static std::size_t popcount(unsigned long long word) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(word);
+#else
+    std::size_t count = 0;
+    for (; word; word &= word - 1) {
+      ++count;
+    }
+    return count;
+#endif
+  }
+
+  std::vector<unsigned long long> m_words;
+};
+
+// Calls work(i) for every i < count, spread over up to `threads` threads
+// (the calling one included). Runs on fewer threads if no more can be
+// started.
+template <class Work>
+void parallel_for(std::size_t count, std::size_t threads, Work work) {
+  std::atomic<std::size_t> next(0);
+  auto run = [&]() {
+    for (std::size_t i; (i = next++) < count;) {
+      work(i);
+    }
+  };
+  std::vector<std::thread> pool;
+  for (std::size_t t = 1; t < std::min(threads, count); ++t) {
+    try {
+      pool.emplace_back(run);
+    } catch (const std::system_error &) {
+      break;
+    }
+  }
+  run();
+  for (auto &thread : pool) {
+    thread.join();
+  }
+}
+
+enum PathCheck : unsigned char {
+  PATH_EXISTS = 1,
+  PATH_IS_DIR = 2,
+  PATH_READABLE = 4
+};
+
+// Why `path` fails any of `checks` (a PathCheck mask), nullptr if it passes.
+const char *check_path(const std::string &path, unsigned char checks) {
+#if defined(__unix__) || defined(__APPLE__)
+  struct stat info;
+  if (::stat(path.c_str(), &info) != 0) {
+    return "does not exist";
+  }
+  if ((checks & PATH_IS_DIR) && !S_ISDIR(info.st_mode)) {
+    return "is not a directory";
+  }
+  if ((checks & PATH_READABLE) && ::access(path.c_str(), R_OK) != 0) {
+    return "is not readable";
+  }
+#else
+  // Without POSIX, only files can be probed, by opening them.
+  if (checks & PATH_IS_DIR) {
+    return nullptr;
+  }
+  std::FILE *file = std::fopen(path.c_str(), "r");
+  if (!file) {
+    return "does not exist or is not readable";
+  }
+  std::fclose(file);
+#endif
+  return nullptr;
+}
+
+// Shortest text that reads back as exactly `value`.
+std::string format_double(double value) {
+  char buffer[32];
+  for (int precision = 1; precision <= 17; ++precision) {
+    std::snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+    if (std::strtod(buffer, nullptr) == value) {
+      break;
+    }
+  }
+  return buffer;
+}
+
+// Open-addressing hash index over "key=value" entries stored elsewhere,
+// mapping every key to the position of its last entry. Only positions and
+// hashes are kept, keys are compared in place, so the entries may move
+// (say, when their vector grows) as long as their order is kept.
+class KeyIndex {
+public:
+  // Indexes entries[entry], whose key is its first `key_length` bytes. An
+  // earlier entry with the same key is replaced.
+  void insert(const std::vector<std::string> &entries, unsigned int entry,
+              std::size_t key_length) {
+    if (2 * (m_size + 1) > m_slots.size()) {
+      grow();
+    }
+    auto hash = hash_key(entries[entry].data(), key_length);
+    auto &slot = m_slots[probe(entries, entries[entry].data(), key_length,
+                               hash)];
+    if (!slot.entry) {
+      ++m_size;
+    }
+    slot = Slot{hash, entry + 1};
+  }
+
+  // Position in `entries` of the last entry for `key`, or -1.
+  long find(const std::vector<std::string> &entries, const char *key,
+            std::size_t key_length) const {
+    if (m_slots.empty()) {
+      return -1;
+    }
+    auto &slot = m_slots[probe(entries, key, key_length,
+                               hash_key(key, key_length))];
+    return static_cast<long>(slot.entry) - 1;
+  }
+
+  void clear() {
+    m_slots.clear();
+    m_size = 0;
+  }
+
+private:
+  struct Slot {
+    std::size_t hash;
+    unsigned int entry; // Position + 1, 0 if the slot is free.
+  };
+
+  // FNV-1a.
+  static std::size_t hash_key(const char *key, std::size_t length) {
+    std::size_t hash = 14695981039346656037ull & ~std::size_t(0);
+    for (std::size_t i = 0; i < length; ++i) {
+      hash = (hash ^ static_cast<unsigned char>(key[i])) * 1099511628211ull;
+    }
+    return hash;
+  }
+
+  // Linear probing from the key's home slot, up to the slot holding it or
+  // the first free one.
+  std::size_t probe(const std::vector<std::string> &entries, const char *key,
+                    std::size_t key_length, std::size_t hash) const {
+    auto mask = m_slots.size() - 1;
+    for (auto i = hash & mask;; i = (i + 1) & mask) {
+      auto &slot = m_slots[i];
+      if (!slot.entry) {
+        return i;
+      }
+      if (slot.hash == hash) {
+        auto &entry = entries[slot.entry - 1];
+        if (entry.size() > key_length && entry[key_length] == '=' &&
+            entry.compare(0, key_length, key, key_length) == 0) {
+          return i;
+        }
+      }
+    }
+  }
+
+  void grow() {
+    std::vector<Slot> slots(m_slots.empty() ? 16 : 2 * m_slots.size());
+    auto mask = slots.size() - 1;
+    for (auto &slot : m_slots) {
+      if (slot.entry) {
+        auto i = slot.hash & mask;
+        while (slots[i].entry) {
+          i = (i + 1) & mask;
+        }
+        slots[i] = slot;
+      }
+    }
+    m_slots.swap(slots);
+  }
+
+  std::vector<Slot> m_slots;
+  std::size_t m_size = 0;
+};
+
+#ifndef OPTIONPARSER_NO_HELP
+
 std::string stitch_str(const std::vector<std::string> &text,
                        unsigned max_per_line = 80,
                        const std::string &leading_str = "") {
-  std::vector<std::string> result;
-
-  std::string line_value;
+  std::string result = leading_str;
+  TextWrapper wrapper(result, max_per_line, leading_str,
+                      display_width(leading_str));
   for (const auto &token : text) {
-    if (line_value.empty()) {
-      line_value = (leading_str + token);
-      continue;
-    }
-
-    auto hypothetical_line = line_value;
-    hypothetical_line.append(" " + token);
+    wrapper.word(token);
+  }
+  return result;
+}
 
-    if (hypothetical_line.size() > max_per_line) {
-      // In this case, we were better off before
-      result.emplace_back(line_value);
-      line_value = (leading_str + token);
-    } else {
-      line_value = hypothetical_line;
+// `words` joined by `separator`, with a backslash before every character
+// a shell would split or expand them on, so that it gets them back as-is.
+std::string shell_words(const std::vector<std::string> &words,
+                        char separator = ' ') {
+  std::string result;
+  for (size_t i = 0; i < words.size(); ++i) {
+    if (i > 0) {
+      result += separator;
+    }
+    for (char c : words[i]) {
+      if (!std::isalnum(static_cast<unsigned char>(c)) &&
+          !std::strchr("-_./=,+@%^", c)) {
+        result += '\\';
+      }
+      result += c;
     }
   }
-  // Collect the last line since we don't track indices in the loop proper.
-  result.emplace_back(line_value);
-  return std::accumulate(
-      result.begin() + 1, result.end(), result.at(0),
-      [](std::string &s, const std::string &piece) -> std::string {
-        return s + "\n" + piece;
-      });
+  return result;
 }
 
+#endif // OPTIONPARSER_NO_HELP
+
 } // end namespace utils
 
 // Define a thin error for any sort of parser error that arises
@@ -73,7 +799,7 @@ class ParserError : public std::runtime_error {
 };
 
 // Enums for Option config
-enum StorageMode { STORE_TRUE = 0, STORE_VALUE, STORE_MULT_VALUES };
+enum StorageMode { STORE_TRUE = 0, STORE_VALUE, STORE_MULT_VALUES, STORE_MAP };
 enum OptionType { LONG_OPT = 0, SHORT_OPT, POSITIONAL_OPT, EMPTY_OPT };
 
 // Option class definition
@@ -81,12 +807,70 @@ class Option {
 public:
   Option() = default;
 
+#ifndef OPTIONPARSER_NO_HELP
   std::string help_doc();
+#endif
 
   std::string &short_flag() { return m_short_flag; }
   std::string &long_flag() { return m_long_flag; }
   std::string &pos_flag() { return m_pos_flag; }
 
+  // Further flags matching this option, e.g. `--threads` and `-j` next to
+  // `--num-threads`. Deprecated aliases keep working but are left out of
+  // the documentation, and warn the first time they are used.
+  struct Alias {
+    std::string flag;
+    bool deprecated;
+  };
+  const std::vector<Alias> &aliases() { return m_aliases; }
+
+  // The values the option accepts, checked as arguments are parsed. Each
+  // one maps to a number, its position or the (enum) value paired with it,
+  // returned by OptionParser::get_choice().
+  struct Choices {
+    std::vector<std::string> names;
+    std::unordered_map<std::string, long long> values;
+  };
+  const Choices *choices() { return m_choices.get(); }
+  Option &choices(const std::vector<std::string> &names) {
+    auto choices = std::make_shared<Choices>();
+    choices->names = names;
+    for (std::size_t i = 0; i < names.size(); ++i) {
+      choices->values.emplace(names[i], i);
+    }
+    m_choices = choices;
+    ++m_revision;
+    return *this;
+  }
+  template <typename E>
+  Option &choices(const std::vector<std::pair<std::string, E>> &pairs) {
+    auto choices = std::make_shared<Choices>();
+    for (const auto &choice : pairs) {
+      choices->names.push_back(choice.first);
+      choices->values.emplace(choice.first,
+                              static_cast<long long>(choice.second));
+    }
+    m_choices = choices;
+    ++m_revision;
+    return *this;
+  }
+  Option &alias(const std::string &flag, bool deprecated = false);
+  Option &deprecated_alias(const std::string &flag) {
+    return alias(flag, true);
+  }
+
+  // Completes values only known at runtime: called with the partial value
+  // when the program runs as `prog --__complete ...` (see
+  // OptionParser::complete), it returns the candidates.
+  using Completer =
+      std::function<std::vector<std::string>(const std::string &prefix)>;
+  const Completer &completer() { return m_completer; }
+  Option &complete_with(Completer completer) {
+    m_completer = std::move(completer);
+    ++m_revision;
+    return *this;
+  }
+
   bool found() { return m_found; }
   Option &found(bool found) {
     m_found = found;
@@ -96,15 +880,30 @@ public:
   StorageMode mode() { return m_mode; }
   Option &mode(const StorageMode &mode) {
     m_mode = mode;
+    ++m_revision;
+    return *this;
+  }
+
+  // Checks on the values of the option as paths, run by the parser for all
+  // options at once once the arguments are parsed.
+  Option &exists() { return path_checks(utils::PATH_EXISTS); }
+  Option &is_dir() { return path_checks(utils::PATH_IS_DIR); }
+  Option &readable() { return path_checks(utils::PATH_READABLE); }
+  unsigned char path_checks() { return m_path_checks; }
+  Option &path_checks(unsigned char checks) {
+    m_path_checks |= checks;
+    ++m_revision;
     return *this;
   }
 
   bool required() { return m_required; }
   Option &required(bool req) {
     m_required = req;
+    ++m_revision;
     return *this;
   }
 
+#ifndef OPTIONPARSER_NO_HELP
   std::string metavar() {
     std::string formatted_metavar;
     if (!m_metavar.empty()) {
@@ -132,38 +931,119 @@ public:
 
   Option &metavar(const std::string &mvar) {
     m_metavar = mvar;
+    ++m_revision;
     return *this;
   }
 
   std::string help() { return m_help; }
   Option &help(const std::string &help) {
     m_help = help;
+    ++m_revision;
     return *this;
   }
+#else
+  // Taking literals as-is lets the compiler drop them along with the call.
+  Option &metavar(const char *) { return *this; }
+  Option &metavar(const std::string &) { return *this; }
+  Option &help(const char *) { return *this; }
+  Option &help(const std::string &) { return *this; }
+#endif
 
-  std::string dest() { return m_dest; }
+  const std::string &dest() { return m_dest; }
   Option &dest(const std::string &dest) {
     m_dest = dest;
+    ++m_revision;
+    return *this;
+  }
+
+  // Makes every value a `separator`-delimited list, read with
+  // OptionParser::get_list(). '\0' (the default) means one element per value.
+  char separator() { return m_separator; }
+  Option &separator(char separator) {
+    m_separator = separator;
+    ++m_revision;
     return *this;
   }
 
-  std::string default_value() { return m_default_value; }
+  const std::string &default_value() { return current_default().text; }
 
   Option &default_value(const std::string &default_value) {
-    m_default_value = default_value;
+    m_default.set(default_value);
+    m_lazy_default.reset();
+    ++m_revision;
     return *this;
   }
 
   Option &default_value(const char *default_value) {
-    m_default_value = std::string(default_value);
+    m_default.set(std::string(default_value));
+    m_lazy_default.reset();
+    ++m_revision;
     return *this;
   }
 
+  // Numeric defaults are kept as they are next to their text, so that
+  // reading them back as numbers is exact and needs no parsing.
   template <typename T> Option &default_value(const T &default_value) {
-    m_default_value = std::to_string(default_value);
+    m_default.set(default_value);
+    m_lazy_default.reset();
+    ++m_revision;
     return *this;
   }
 
+  // A default computed by `compute()` (returning a string or a number) the
+  // first time it is read, which only happens if the option is read without
+  // having been given. Evaluation happens at most once, even when several
+  // threads read the option concurrently.
+  template <typename F> Option &default_from(F compute) {
+    m_default = Default();
+    m_lazy_default = std::make_shared<LazyDefault>();
+    m_lazy_default->compute = [compute](Default &value) {
+      value.set(compute());
+    };
+    ++m_revision;
+    return *this;
+  }
+
+  bool has_default() { return m_lazy_default || !m_default.text.empty(); }
+
+  bool has_number_default() {
+    return current_default().kind != Default::STRING;
+  }
+  // Throws std::out_of_range, as the std::sto* functions do for defaults
+  // given as text, if the default does not fit in T.
+  template <typename T> T number_default() {
+    auto &value = current_default();
+    bool fits;
+    switch (value.kind) {
+    case Default::SIGNED:
+      fits = utils::in_range<T>(value.number.i);
+      break;
+    case Default::UNSIGNED:
+      fits = utils::in_range<T>(value.number.u);
+      break;
+    default:
+      fits = utils::in_range<T>(value.number.d);
+      break;
+    }
+    if (!fits) {
+      throw std::out_of_range("default value " + value.text +
+                              " is out of range");
+    }
+    switch (value.kind) {
+    case Default::SIGNED:
+      return static_cast<T>(value.number.i);
+    case Default::UNSIGNED:
+      return static_cast<T>(value.number.u);
+    default:
+      return static_cast<T>(value.number.d);
+    }
+  }
+
+  // Bumped by every setter that affects how the option is matched or
+  // documented, so that the parser can tell when its flag index or cached
+  // help text went stale.
+  unsigned long revision() { return m_revision; }
+
   static OptionType get_type(std::string opt);
   static std::string get_destination(const std::string &first_option,
                                      const std::string &second_option);
@@ -171,20 +1051,92 @@ public:
                                     const OptionType &second_option_type);
 
 private:
-  bool m_found = false;
-  bool m_required = false;
+  // A default value: its text and, if it was given as a number, the number.
+  struct Default {
+    enum Kind : unsigned char { STRING, SIGNED, UNSIGNED, FLOAT };
+
+    std::string text;
+    Kind kind = STRING;
+    union {
+      long long i;
+      unsigned long long u;
+      double d;
+    } number = {0};
+
+    void set(const std::string &value) {
+      text = value;
+      kind = STRING;
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value &&
+                            std::is_signed<T>::value>::type
+    set(T value) {
+      kind = SIGNED;
+      number.i = value;
+      text = std::to_string(number.i);
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value &&
+                            !std::is_signed<T>::value>::type
+    set(T value) {
+      kind = UNSIGNED;
+      number.u = value;
+      text = std::to_string(number.u);
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_floating_point<T>::value>::type
+    set(T value) {
+      kind = FLOAT;
+      number.d = value;
+      text = utils::format_double(number.d);
+    }
+  };
+
+  // Shared between copies of the option, as std::once_flag cannot be
+  // copied; they all compute the same value anyway.
+  struct LazyDefault {
+    std::once_flag once;
+    std::function<void(Default &)> compute;
+    Default value;
+  };
+
+  Default &current_default() {
+    if (!m_lazy_default) {
+      return m_default;
+    }
+    auto &lazy = *m_lazy_default;
+    std::call_once(lazy.once, [&lazy]() { lazy.compute(lazy.value); });
+    return lazy.value;
+  }
+
+  bool m_found = false;
+  bool m_required = false;
+  unsigned long m_revision = 0;
   StorageMode m_mode = STORE_TRUE;
-  std::string m_help = "";
+  char m_separator = '\0';
+  unsigned char m_path_checks = 0;
   std::string m_dest = "";
-  std::string m_default_value = "";
+  Default m_default;
+  std::shared_ptr<LazyDefault> m_lazy_default;
+#ifndef OPTIONPARSER_NO_HELP
+  std::string m_help = "";
   std::string m_metavar = "";
+#endif
 
   std::string m_short_flag = "";
   std::string m_long_flag = "";
   std::string m_pos_flag = "";
+  std::vector<Alias> m_aliases;
+  // Shared between copies, the table can be large and never changes.
+  std::shared_ptr<const Choices> m_choices;
+  Completer m_completer;
 };
 
 // Non-inline definitions for Option methods
+#ifndef OPTIONPARSER_NO_HELP
 std::string Option::help_doc() {
   std::string h = "    ";
   if (!m_long_flag.empty()) {
@@ -199,14 +1151,32 @@ std::string Option::help_doc() {
   if (!m_pos_flag.empty()) {
     h += m_pos_flag;
   }
+  for (const auto &alias : m_aliases) {
+    if (!alias.deprecated) {
+      h += ", " + alias.flag;
+    }
+  }
+
+  auto arg_buf = std::max(utils::display_width(h) + 1,
+                          static_cast<std::size_t>(25));
+  h.resize(h.size() + arg_buf - utils::display_width(h), ' ');
+  utils::TextWrapper wrapper(h, utils::layout_width(arg_buf + 50, arg_buf + 20),
+                             std::string(arg_buf, ' '), arg_buf);
+  wrapper.words(m_help);
+  h += '\n';
+  return h;
+}
+#endif
 
-  auto arg_buf = std::max(h.length() + 1, static_cast<unsigned long>(25));
-  auto help_str = utils::stitch_str(utils::split_str(m_help), arg_buf + 50,
-                                    std::string(arg_buf, ' '));
-  char char_buf[h.length() + help_str.length() + 100];
-  sprintf(char_buf, ("%-" + std::to_string(arg_buf) + "s%s\n").c_str(),
-          h.c_str(), help_str.substr(arg_buf).c_str());
-  return std::string(char_buf);
+Option &Option::alias(const std::string &flag, bool deprecated) {
+  auto type = get_type(flag);
+  if (type != OptionType::LONG_OPT && type != OptionType::SHORT_OPT) {
+    throw std::runtime_error("Parser inconsistency: alias '" + flag +
+                             "' must be a short or long flag.");
+  }
+  m_aliases.push_back(Alias{flag, deprecated});
+  ++m_revision;
+  return *this;
 }
 
 OptionType Option::get_type(std::string opt) {
@@ -279,12 +1249,27 @@ std::string Option::get_destination(const std::string &first_option,
   return dest;
 }
 
+// One step of a parse as reported by ArgumentReader: `option` was matched
+// and, for options that store values, `value` is one of them. `value` points
+// into the arguments being read (or at the option's default) and stays valid
+// until the next step.
+struct ParseEvent {
+  Option *option;
+  const char *value;
+};
+
+template <class Iterator> class ArgumentReader;
+
 // OptionParser class definition
 class OptionParser {
 public:
   explicit OptionParser(std::string description = "", bool create_help = true)
-      : m_options(0), m_description(std::move(description)),
-        m_pos_args_count(1), m_exit_on_failure(true) {
+      : m_options(0), m_exit_on_failure(true) {
+#ifndef OPTIONPARSER_NO_HELP
+    m_description = std::move(description);
+#else
+    (void)description;
+#endif
     if (create_help) {
       add_option("--help", "-h").help("Display this help message and exit.");
     }
@@ -294,19 +1279,159 @@ public:
 
   void eat_arguments(unsigned int argc, char const *argv[]);
 
+  // Parses any range of string-like elements (std::string, const char *,
+  // string views, ...) without first building an argv array. As with argv,
+  // the first element is the program name. Values are copied as they are
+  // stored, so the arguments need not outlive the call.
+  template <class Iterator> void eat_arguments(Iterator first, Iterator last);
+  template <class Range> void eat_arguments(const Range &args);
+
+  // Incremental parsing, for arguments that arrive one at a time:
+  // begin_arguments() resets the parser, feed() consumes the next argument
+  // and end_arguments() wraps up just like the end of eat_arguments() does
+  // (help, defaults and required options). feed() returns how many options
+  // the argument completed; those can be read with get_value() right away.
+  // An option taking values is complete once its value (STORE_VALUE) or the
+  // next flag (STORE_MULT_VALUES) has been fed.
+  void begin_arguments(const std::string &prog_name = "");
+  std::size_t feed(const char *argument);
+  std::size_t feed(const std::string &argument);
+  void end_arguments();
+
+  // Like eat_arguments(), but instead of failing on arguments that match no
+  // option (nor a free positional slot) it hands them back, in order. A
+  // "--" ends option matching: everything after it is handed back as-is,
+  // without being looked at. The result points into the caller's arguments.
+  std::vector<char const *> parse_known_args(unsigned int argc,
+                                             char const *argv[]);
+  template <class Iterator>
+  std::vector<Iterator> parse_known_args(Iterator first, Iterator last);
+
+  // Pull-style parsing: returns a reader that yields a ParseEvent per flag,
+  // value and positional argument, in argument order, while parsing. Values
+  // are handed out instead of being stored for get_value(), and stopping
+  // early leaves the remaining arguments untouched. Reading to the end runs
+  // end_arguments().
+  ArgumentReader<char const **> read_arguments(unsigned int argc,
+                                               char const *argv[]);
+  template <class Iterator>
+  ArgumentReader<Iterator> read_arguments(Iterator first, Iterator last);
+
+  // Parses a whole command line such as `run --threads 8 --name "a b"`, with
+  // POSIX shell quoting and escaping (see utils::tokenize_command_line). The
+  // first word plays the part of argv[0].
+  void parse_command_line(const std::string &command);
+
+  // Candidates for completing words[index] given the words of a partial
+  // command line, words[0] being the program name: the flags, choices,
+  // subcommands or completer results (see Option::complete_with) starting
+  // with the word typed so far. Nothing is stored, converted or checked.
+  // eat_arguments(argc, argv) answers `prog --__complete <index> <words...>`
+  // by printing them one per line and exiting, which is how the generated
+  // completion scripts ask for values of options with a completer. Other
+  // entry points, and parsers set to throw_on_failure(), treat
+  // `--__complete` as an ordinary argument.
+  std::vector<std::string> complete(const std::vector<std::string> &words,
+                                    std::size_t index);
+
   Option &add_option(const std::string &first_option,
                      const std::string &second_option = "");
 
   // We template-specialize these later
   template <class T = bool> T get_value(const std::string &key);
 
+  // Elements of all values of a list option (see Option::separator),
+  // decoded straight from the arguments as integers, floating point
+  // numbers or strings. The second form writes at most `capacity` of them
+  // to `out`, and returns the total number of elements.
+  template <class T> std::vector<T> get_list(const std::string &key);
+  template <class T>
+  std::size_t get_list(const std::string &key, T *out, std::size_t capacity);
+
+  // Number of the choice (see Option::choices) given for `key`, as an int
+  // or as the enum type the choices were declared with.
+  template <class E = int> E get_choice(const std::string &key);
+  template <class E = int> std::vector<E> get_choices(const std::string &key);
+
+  // Value of `map_key` in a STORE_MAP option, which takes `key=value`
+  // arguments and can be repeated; the last value given for a key wins.
+  // nullptr if the key was not given.
+  const char *get_map_value(const std::string &key, const std::string &map_key);
+
   void help();
 
+#ifndef OPTIONPARSER_NO_HELP
+  // The full text printed by help(). It is laid out on first use and cached
+  // until an option is added or changed.
+  const std::string &help_text();
+
+  // The same documentation as a troff man page (section 1) and as Markdown.
+  std::string man_page();
+  std::string markdown();
+
+  // A completion script for `shell` ("bash", "zsh" or "fish") listing the
+  // flags, choices and whether values are files or directories, so that
+  // completing never has to run the program.
+  std::string completion_script(const std::string &shell);
+#endif
+
+  // Have help() print `text` as-is instead of laying out help_text(). Meant
+  // for help generated at build time, see optionparser_generate_docs() in
+  // cmake/OptionParserDocs.cmake. The buffer must outlive the parser.
+  OptionParser &precomputed_help(const char *text);
+
+  // Program name shown in usage lines; eat_arguments() sets it from argv[0].
+  OptionParser &prog_name(const std::string &name);
+
+  // Registers a subcommand, selected by the first positional argument that
+  // names one. `factory` adds the subcommand's options to a fresh parser,
+  // and only runs once the subcommand has been selected; all arguments
+  // after its name are then parsed by that parser.
+  OptionParser &add_subcommand(const std::string &name,
+                               std::function<void(OptionParser &)> factory,
+                               const std::string &help = "");
+
+  // Name of the subcommand selected by the last parse (empty if none) and
+  // the parser that handled its arguments.
+  const std::string &subcommand() { return m_subcommand; }
+  OptionParser &subparser();
+
   OptionParser &exit_on_failure(bool exit = true);
 
   OptionParser &throw_on_failure(bool throw_ = true);
 
+  // Registered flags (or, for arguments not starting with '-', subcommand
+  // names) closest to `argument` by edit distance, best first. Used for the
+  // "did you mean" hint of unrecognized arguments.
+  std::vector<std::string> suggest(const std::string &argument,
+                                   std::size_t max_suggestions = 3);
+
+  // Whether unambiguous prefixes of long flags (`--verb` for `--verbose`)
+  // are accepted. On by default, but never by parse_known_args(), which
+  // hands such prefixes back.
+  OptionParser &allow_abbrev(bool allow = true);
+
+  // add_option() rejects a flag that is already registered right away.
+  // Schemas with thousands of options can defer those checks, and have
+  // validate() (or the first parse) report every duplicate flag and dest in
+  // one pass instead.
+  OptionParser &defer_validation(bool defer = true);
+  void validate();
+
+  // Constraints between options, named by dest and checked after every
+  // parse against the options that were actually given (defaults don't
+  // count). All violated constraints are reported together.
+  OptionParser &exactly_one_of(const std::vector<std::string> &dests);
+  OptionParser &at_most_one_of(const std::vector<std::string> &dests);
+  OptionParser &at_least(std::size_t count,
+                         const std::vector<std::string> &dests);
+  // If `dest` is given, so must be every option in `required`.
+  OptionParser &requires_options(const std::string &dest,
+                                 const std::vector<std::string> &required);
+
 private:
+  template <class Iterator> friend class ArgumentReader;
+
   Option &add_option_internal(const std::string &first_option,
                               const std::string &second_option);
 
@@ -316,24 +1441,268 @@ private:
 
   ParserError fail_unrecognized_argument(const std::string &arg);
 
+  ParserError fail_invalid_choice(Option &option, const std::string &value);
+
+  long long choice_value(Option &option, const std::string &value);
+
   ParserError
   fail_for_missing_arguments(const std::vector<std::string> &missing_flags);
 
-  bool get_value_arg(std::vector<std::string> &arguments, unsigned int &arg,
-                     Option &opt, std::string &flag);
+  // Values given for `key`, or nullptr if its default applies instead.
+  const std::vector<std::string> *stored_values(const std::string &key,
+                                                Option *&option);
+
+  template <class T, class Sink>
+  std::size_t decode_list(const std::string &key, Sink sink);
+
+  // Arguments that are not NUL-terminated strings go through m_element.
+  template <class T> std::size_t feed_element(const T &argument) {
+    utils::assign_str(m_element, argument, 0);
+    return feed(m_element);
+  }
+  std::size_t feed_element(const char *argument) { return feed(argument); }
+  std::size_t feed_element(char *argument) { return feed(argument); }
+  std::size_t feed_element(const std::string &argument) {
+    return feed(argument);
+  }
+
+  std::size_t finish_pending();
+
+  std::unordered_map<std::string, unsigned int>::iterator
+  find_abbreviation(const std::string &prefix);
+  std::pair<std::vector<std::pair<std::string, unsigned int>>::iterator,
+            std::vector<std::pair<std::string, unsigned int>>::iterator>
+  long_flags_starting_with(const std::string &prefix);
+
+  void print_completions(const std::vector<std::string> &request);
+  int completed_flag(const std::string &flag);
+  void complete_value(Option &option, const std::string &prefix,
+                      std::vector<std::string> &candidates,
+                      const std::string &leading = "");
+
+  void warn_if_deprecated(const std::string &flag, unsigned int idx);
+
+  bool is_short_cluster(const char *argument);
+  std::size_t feed_short_cluster(const char *argument);
+
+  std::size_t feed_subparser(const char *argument);
+  std::shared_ptr<OptionParser> make_subparser(unsigned int subcommand_idx);
 
-  bool try_to_get_opt(std::vector<std::string> &arguments, unsigned int &arg,
-                      Option &option, std::string &flag);
+  void index_map_entry(const std::string &dest,
+                       const std::vector<std::string> &values);
+
+  void build_index();
+  void compile_constraints();
+  void check_constraints(const utils::Bitset &given);
+  void check_paths();
+  std::string flag_name(Option &option);
+
+  void store_value(unsigned int idx, const char *value);
 
   void check_for_missing_args();
 
+  unsigned long schema_revision();
+
+#ifndef OPTIONPARSER_NO_HELP
+  std::string option_usage(Option &option);
+
+  std::string short_prog_name();
+
+  // How the value of an option is completed.
+  enum ValueHint {
+    NO_VALUE,
+    ANY_VALUE,
+    FILE_VALUE,
+    DIR_VALUE,
+    CHOICE_VALUE,
+    DYNAMIC_VALUE
+  };
+  ValueHint value_hint(Option &option);
+  std::vector<std::string> documented_flags(Option &option);
+
+  std::string completion_function();
+  std::string bash_completion();
+  std::string zsh_completion();
+  std::string fish_completion();
+#endif
+
   std::map<std::string, std::vector<std::string>> m_values;
-  int m_pos_args_count;
+  // Key index of every STORE_MAP option, over its entries in m_values.
+  std::map<std::string, utils::KeyIndex> m_maps;
   std::vector<Option> m_options;
-  std::string m_prog_name, m_description;
-  std::vector<std::string> m_positional_options_names;
+  std::string m_prog_name;
+#ifndef OPTIONPARSER_NO_HELP
+  std::string m_description;
+#endif
   std::map<std::string, unsigned int> m_option_idx;
   bool m_exit_on_failure;
+
+  // Indices rebuilt by begin_arguments() whenever the options changed:
+  // flag -> option index (first registration wins) and positional options in
+  // order. Then the parse state proper, including the option still waiting
+  // for values along with the flag that introduced it.
+  std::unordered_map<std::string, unsigned int> m_flag_idx;
+  // Option index + 1 of every single-character short flag, 0 if unused.
+  unsigned int m_short_idx[256] = {};
+  // Long flags in sorted order, so that all flags sharing a prefix are
+  // adjacent.
+  std::vector<std::pair<std::string, unsigned int>> m_long_flags;
+  bool m_allow_abbrev = true;
+  bool m_defer_validation = false;
+
+  // Option constraints, as registered and as bitmasks over option indices
+  // once compiled with the flag index.
+  struct Constraint {
+    enum Kind { EXACTLY_ONE, AT_MOST_ONE, AT_LEAST, REQUIRES };
+    Kind kind;
+    std::size_t count;
+    std::string subject;
+    std::vector<std::string> dests;
+    unsigned int subject_idx;
+    utils::Bitset mask;
+  };
+  std::vector<Constraint> m_constraints;
+
+  OptionParser &add_constraint(Constraint::Kind kind, std::size_t count,
+                               const std::string &subject,
+                               const std::vector<std::string> &dests);
+
+  // Deprecated aliases, and whether they already warned.
+  std::unordered_map<std::string, bool> m_deprecated_flags;
+  std::vector<unsigned int> m_positional_idx;
+  unsigned long m_index_revision = 0;
+  std::size_t m_positionals_seen = 0;
+  int m_pending = -1;
+  std::size_t m_pending_values = 0;
+  std::string m_pending_flag;
+  std::vector<ParseEvent> *m_events = nullptr;
+  // Values of options with path checks handed out as events, which are not
+  // stored, kept for check_paths().
+  std::vector<std::pair<unsigned int, std::string>> m_event_paths;
+  // After a "--", arguments are never matched against flags.
+  bool m_options_ended = false;
+  // Whether unrecognized arguments are let through (parse_known_args), and
+  // whether the last one fed was.
+  bool m_allow_unknown = false;
+  bool m_unrecognized = false;
+
+  struct Subcommand {
+    std::string name;
+#ifndef OPTIONPARSER_NO_HELP
+    std::string help;
+#endif
+    std::function<void(OptionParser &)> factory;
+  };
+  std::vector<Subcommand> m_subcommands;
+  std::unordered_map<std::string, unsigned int> m_subcommand_idx;
+  std::string m_subcommand;
+  std::shared_ptr<OptionParser> m_subparser;
+
+#ifndef OPTIONPARSER_NO_HELP
+  std::string m_help_cache;
+  std::string m_help_cache_prog_name;
+  unsigned long m_help_cache_revision = 0;
+#endif
+  const char *m_precomputed_help = nullptr;
+  std::string m_command_line;
+  std::string m_element;
+};
+
+// Pulls ParseEvents out of an OptionParser one at a time, parsing only as far
+// as needed to produce the next one. See OptionParser::read_arguments().
+template <class Iterator> class ArgumentReader {
+public:
+  ArgumentReader(OptionParser &parser, Iterator first, Iterator last)
+      : m_parser(&parser), m_next(first), m_last(last) {
+    if (m_next == m_last) {
+      parser.begin_arguments();
+    } else {
+      utils::assign_str(m_scratch, *m_next, 0);
+      parser.begin_arguments(m_scratch);
+      ++m_next;
+    }
+  }
+
+  // Fills in the next event and returns true, or returns false once every
+  // argument has been read.
+  bool next(ParseEvent &event) {
+    while (m_head == m_events.size()) {
+      if (m_done) {
+        return false;
+      }
+      m_events.clear();
+      m_head = 0;
+      EventSink sink(*m_parser, m_events);
+      if (m_next == m_last) {
+        m_done = true;
+        m_parser->end_arguments();
+      } else {
+        feed(*m_next);
+        ++m_next;
+      }
+    }
+    event = m_events[m_head++];
+    return true;
+  }
+
+  class iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = ParseEvent;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const ParseEvent *;
+    using reference = const ParseEvent &;
+
+    iterator() = default;
+    explicit iterator(ArgumentReader *reader) : m_reader(reader) { ++*this; }
+
+    reference operator*() const { return m_event; }
+    pointer operator->() const { return &m_event; }
+    iterator &operator++() {
+      if (!m_reader->next(m_event)) {
+        m_reader = nullptr;
+      }
+      return *this;
+    }
+    bool operator==(const iterator &other) const {
+      return m_reader == other.m_reader;
+    }
+    bool operator!=(const iterator &other) const { return !(*this == other); }
+
+  private:
+    ArgumentReader *m_reader = nullptr;
+    ParseEvent m_event = ParseEvent();
+  };
+
+  iterator begin() { return iterator(this); }
+  iterator end() { return iterator(); }
+
+private:
+  // Points the parser at our event queue for the duration of one step.
+  struct EventSink {
+    EventSink(OptionParser &parser, std::vector<ParseEvent> &events)
+        : m_parser(parser) {
+      m_parser.m_events = &events;
+    }
+    ~EventSink() { m_parser.m_events = nullptr; }
+    OptionParser &m_parser;
+  };
+
+  void feed(const char *argument) { m_parser->feed(argument); }
+  void feed(const std::string &argument) { m_parser->feed(argument); }
+  // Other string-like arguments are converted, and kept alive for the
+  // events pointing into them.
+  template <class T> void feed(const T &argument) {
+    utils::assign_str(m_scratch, argument, 0);
+    m_parser->feed(m_scratch);
+  }
+
+  OptionParser *m_parser;
+  Iterator m_next, m_last;
+  std::vector<ParseEvent> m_events;
+  std::size_t m_head = 0;
+  bool m_done = false;
+  std::string m_scratch;
 };
 
 // Define methods non-inline
@@ -344,10 +1713,22 @@ Option &OptionParser::add_option(const std::string &first_option,
 
 Option &OptionParser::add_option_internal(const std::string &first_option,
                                           const std::string &second_option) {
-  m_options.resize(m_options.size() + 1);
-  Option &opt = m_options.back();
   OptionType first_option_type = Option::get_type(first_option);
   OptionType second_option_type = Option::get_type(second_option);
+  if (!m_defer_validation) {
+    // The flag index is kept up to date with every registration, so a
+    // conflicting flag is a single lookup.
+    for (const auto *flag : {&first_option, &second_option}) {
+      if (!flag->empty() && m_flag_idx.count(*flag)) {
+        std::string msg = "Parser inconsistency: flag '" + *flag +
+                          "' is already registered.";
+        try_to_exit_with_message(msg);
+        throw std::runtime_error(msg);
+      }
+    }
+  }
+  m_options.resize(m_options.size() + 1);
+  Option &opt = m_options.back();
 
   try {
     opt.dest(Option::get_destination(first_option, second_option));
@@ -369,206 +1750,1044 @@ Option &OptionParser::add_option_internal(const std::string &first_option,
   }
   if (first_option_type == OptionType::POSITIONAL_OPT) {
     opt.pos_flag() = first_option;
-    m_pos_args_count += 1;
-    m_positional_options_names.push_back(first_option);
+  }
+  if (!m_defer_validation) {
+    unsigned int idx = m_options.size() - 1;
+    for (const auto *flag : {&opt.long_flag(), &opt.short_flag()}) {
+      if (!flag->empty()) {
+        m_flag_idx.emplace(*flag, idx);
+      }
+    }
   }
   return opt;
 }
 
-bool OptionParser::get_value_arg(std::vector<std::string> &arguments,
-                                 unsigned int &arg, Option &opt,
-                                 std::string &flag) {
-  std::string val;
-  m_values[opt.dest()].clear();
+void OptionParser::check_for_missing_args() {
+  std::vector<std::string> missing;
+  for (auto &opt : m_options) {
+    if ((opt.required()) && (!opt.found())) {
+      missing.push_back(opt.dest());
+    } else if (opt.has_default() && (!opt.found())) {
+      // Nothing to store: readers fall back to the default themselves.
+      opt.found(true);
+    }
+  }
+  if (!missing.empty()) {
+    throw fail_for_missing_arguments(missing);
+  }
+}
+
+void OptionParser::eat_arguments(unsigned int argc, char const *argv[]) {
+  // Only main()'s arguments, and only for parsers allowed to exit.
+  if (m_exit_on_failure && argc > 1 &&
+      std::strcmp(argv[1], "--__complete") == 0) {
+    print_completions(std::vector<std::string>(argv + 2, argv + argc));
+  }
+  begin_arguments(argc ? argv[0] : "");
+  for (unsigned int arg = 1; arg < argc; ++arg) {
+    feed(argv[arg]);
+  }
+  end_arguments();
+}
+
+template <class Iterator>
+void OptionParser::eat_arguments(Iterator first, Iterator last) {
+  if (first == last) {
+    begin_arguments();
+  } else {
+    utils::assign_str(m_element, *first, 0);
+    begin_arguments(m_element);
+    for (++first; first != last; ++first) {
+      feed_element(*first);
+    }
+  }
+  end_arguments();
+}
+
+template <class Range> void OptionParser::eat_arguments(const Range &args) {
+  using std::begin;
+  using std::end;
+  eat_arguments(begin(args), end(args));
+}
+
+unsigned long OptionParser::schema_revision() {
+  // Revisions only ever grow, so the sum changes whenever any option does.
+  unsigned long revision =
+      m_options.size() + m_subcommands.size() + m_constraints.size();
+  for (auto &option : m_options) {
+    revision += option.revision();
+  }
+  return revision;
+}
 
-  if (arguments[arg].size() > flag.size()) {
-    auto search_pt = arguments[arg].find_first_of('=');
+void OptionParser::begin_arguments(const std::string &prog_name) {
+  // Every parse starts from a clean slate, so a parser can be reused.
+  m_prog_name = prog_name;
+  m_values.clear();
+  m_maps.clear();
+  m_event_paths.clear();
+  for (auto &opt : m_options) {
+    opt.found(false);
+  }
+  m_positionals_seen = 0;
+  m_pending = -1;
+  m_options_ended = false;
+  m_unrecognized = false;
+  m_subcommand.clear();
+  m_subparser.reset();
+
+  if (schema_revision() != m_index_revision) {
+    build_index();
+  }
+}
 
-    if (search_pt == std::string::npos) {
-      search_pt = arguments[arg].find_first_of(' ');
+void OptionParser::validate() { build_index(); }
 
-      if (search_pt == std::string::npos) {
-        try_to_exit_with_message("Error, long options (" + flag +
-                                 ") require a '=' or space before a value.");
-        return false;
-      }
-      auto vals = utils::split_str(arguments[arg].substr(search_pt + 1));
-      for (const auto &v : vals) {
-        m_values[opt.dest()].push_back(v);
+OptionParser &OptionParser::defer_validation(bool defer) {
+  m_defer_validation = defer;
+  return *this;
+}
+
+// Rebuilds every lookup structure from the options, reporting all flags
+// and dests that are registered more than once.
+void OptionParser::build_index() {
+  auto revision = schema_revision();
+  std::vector<std::string> conflicts;
+  m_option_idx.clear();
+  m_flag_idx.clear();
+  std::fill(std::begin(m_short_idx), std::end(m_short_idx), 0u);
+  m_long_flags.clear();
+  m_positional_idx.clear();
+  for (unsigned int idx = 0; idx < m_options.size(); ++idx) {
+    auto &opt = m_options[idx];
+    if (!m_option_idx.emplace(opt.dest(), idx).second) {
+      conflicts.push_back("dest '" + opt.dest() +
+                          "' is used by more than one option");
+    }
+    for (const auto *flag : {&opt.long_flag(), &opt.short_flag()}) {
+      if (!flag->empty() && !m_flag_idx.emplace(*flag, idx).second) {
+        conflicts.push_back("flag '" + *flag + "' is registered twice");
       }
     }
-  } else {
-    if (arg + 1 >= arguments.size()) {
-      if (opt.default_value().empty()) {
-        try_to_exit_with_message("error, flag '" + flag +
-                                 "' requires an argument.");
-        return false;
+    for (const auto &alias : opt.aliases()) {
+      if (!m_flag_idx.emplace(alias.flag, idx).second) {
+        conflicts.push_back("flag '" + alias.flag + "' is registered twice");
       }
-      if (m_values[opt.dest()].empty()) {
-        val = opt.default_value();
+      if (alias.deprecated) {
+        m_deprecated_flags.emplace(alias.flag, false);
       }
-    } else {
-      if (arguments[arg + 1][0] == '-') {
-        if (opt.default_value().empty()) {
-          try_to_exit_with_message("error, flag '" + flag +
-                                   "' requires an argument.");
-          return false;
-        }
-        if (m_values[opt.dest()].empty()) {
-          val = opt.default_value();
+    }
+    auto &short_flag = opt.short_flag();
+    if (short_flag.size() == 2) {
+      auto &slot = m_short_idx[static_cast<unsigned char>(short_flag[1])];
+      if (!slot) {
+        slot = idx + 1;
+      }
+    }
+    if (!opt.long_flag().empty()) {
+      m_long_flags.emplace_back(opt.long_flag(), idx);
+    }
+    for (const auto &alias : opt.aliases()) {
+      if (alias.flag[1] != '-') {
+        auto &slot = m_short_idx[static_cast<unsigned char>(alias.flag[1])];
+        if (!slot) {
+          slot = idx + 1;
         }
+      } else {
+        m_long_flags.emplace_back(alias.flag, idx);
       }
     }
+    if (!opt.pos_flag().empty()) {
+      m_positional_idx.push_back(idx);
+    }
   }
+  std::sort(m_long_flags.begin(), m_long_flags.end());
+  if (!conflicts.empty()) {
+    auto msg = "Parser inconsistency: " +
+               std::accumulate(conflicts.begin() + 1, conflicts.end(),
+                               conflicts.front(),
+                               [](const std::string &s,
+                                  const std::string &piece) -> std::string {
+                                 return s + "; " + piece;
+                               }) +
+               ".";
+    try_to_exit_with_message(msg);
+    throw std::runtime_error(msg);
+  }
+  compile_constraints();
+  m_index_revision = revision;
+}
 
-  if (!val.empty()) {
-    m_values[opt.dest()].push_back(val);
-    return true;
+std::size_t OptionParser::feed(const std::string &argument) {
+  return feed(argument.c_str());
+}
+
+std::size_t OptionParser::feed(const char *argument) {
+  if (m_subparser) {
+    return feed_subparser(argument);
   }
-  int arg_distance = 0;
-  while (arguments[arg + 1][0] != '-') {
-    arg++;
-    if (arg_distance && (opt.mode() != StorageMode::STORE_MULT_VALUES)) {
-      break;
+  std::size_t completed = 0;
+  m_unrecognized = false;
+  if (m_options_ended) {
+    if (!m_allow_unknown && m_positionals_seen < m_positional_idx.size()) {
+      auto idx = m_positional_idx[m_positionals_seen++];
+      m_options[idx].found(true);
+      store_value(idx, argument);
+      return 1;
     }
-    arg_distance++;
-    m_values[opt.dest()].push_back(arguments[arg]);
-    if (arg + 1 >= arguments.size()) {
-      break;
+    if (m_allow_unknown) {
+      m_unrecognized = true;
+      return 0;
+    }
+    if (m_flag_idx.count(argument)) {
+      auto msg = "error, flag '" + std::string(argument) +
+                 "' comes after '--', where flags are not recognized.";
+      try_to_exit_with_message(msg);
+      throw ParserError(msg);
     }
+    throw fail_unrecognized_argument(argument);
+  }
+  if (m_pending >= 0) {
+    auto &opt = m_options[m_pending];
+    if (argument[0] != '-') {
+      store_value(m_pending, argument);
+      ++m_pending_values;
+      if (opt.mode() == STORE_MULT_VALUES) {
+        return 0;
+      }
+      return finish_pending();
+    }
+    completed += finish_pending();
   }
 
-  return true;
-}
-
-bool OptionParser::try_to_get_opt(std::vector<std::string> &arguments,
-                                  unsigned int &arg, Option &option,
-                                  std::string &flag) {
-  if (flag.empty()) {
-    return false;
+  if (argument[0] == '-' && argument[1] == '-' && argument[2] == '\0') {
+    m_options_ended = true;
+    return completed;
   }
 
-  if (arguments[arg] != flag) {
-    return false;
+  const char *value = nullptr;
+  auto flag = m_flag_idx.find(argument);
+  if (flag == m_flag_idx.end() && argument[0] == '-' && argument[1] == '-') {
+    // --flag=value
+    const char *eq = std::strchr(argument, '=');
+    std::string name = eq ? std::string(argument, eq) : std::string(argument);
+    if (eq) {
+      flag = m_flag_idx.find(name);
+      value = eq + 1;
+    }
+    // Unknown arguments are passed on, and may well be prefixes of ours.
+    if (flag == m_flag_idx.end() && m_allow_abbrev && !m_allow_unknown &&
+        name.size() > 2) {
+      flag = find_abbreviation(name);
+    }
   }
 
-  if (!option.pos_flag().empty()) {
-    m_values[option.dest()].push_back(option.pos_flag());
-    option.found(true);
-    return true;
+  if (flag != m_flag_idx.end()) {
+    auto &opt = m_options[flag->second];
+    if (opt.mode() == STORE_TRUE && !value) {
+      warn_if_deprecated(flag->first, flag->second);
+      opt.found(true);
+      store_value(flag->second, nullptr);
+      return completed + 1;
+    }
+    if (opt.mode() != STORE_TRUE &&
+        (!opt.found() || opt.mode() == STORE_MAP)) {
+      warn_if_deprecated(flag->first, flag->second);
+      if (!m_events && !opt.found()) {
+        m_values[opt.dest()].clear();
+      }
+      m_pending = flag->second;
+      m_pending_values = 0;
+      m_pending_flag = flag->first;
+      if (value) {
+        store_value(m_pending, value);
+        ++m_pending_values;
+        return completed + finish_pending();
+      }
+      return completed;
+    }
   }
 
-  if (option.mode() == STORE_TRUE) {
-    option.found(true);
-    return true;
+  if (is_short_cluster(argument)) {
+    return completed + feed_short_cluster(argument);
   }
 
-  if (((option.mode() == STORE_VALUE) ||
-       (option.mode() == STORE_MULT_VALUES)) &&
-      !option.found()) {
-    if (get_value_arg(arguments, arg, option, flag)) {
-      option.found(true);
-      return true;
-    }
+  auto sub = m_subcommand_idx.find(argument);
+  if (sub != m_subcommand_idx.end()) {
+    m_subparser = make_subparser(sub->second);
+    m_subcommand = m_subcommands[sub->second].name;
+    m_subparser->begin_arguments(m_prog_name + " " + m_subcommand);
+    return completed;
   }
 
-  return false;
+  if (m_positionals_seen < m_positional_idx.size()) {
+    auto idx = m_positional_idx[m_positionals_seen++];
+    m_options[idx].found(true);
+    store_value(idx, argument);
+    return completed + 1;
+  }
+  if (m_allow_unknown) {
+    m_unrecognized = true;
+    return completed;
+  }
+  if (flag != m_flag_idx.end()) {
+    // Only options taking values end up here, once they were given.
+    auto msg = "error, flag '" + flag->first + "' was given more than once.";
+    try_to_exit_with_message(msg);
+    throw ParserError(msg);
+  }
+  throw fail_unrecognized_argument(argument);
 }
 
-void OptionParser::check_for_missing_args() {
-  std::vector<std::string> missing;
-  for (auto &opt : m_options) {
-    if ((opt.required()) && (!opt.found())) {
-      missing.push_back(opt.dest());
-    } else if ((!opt.default_value().empty()) && (!opt.found())) {
-      m_values[opt.dest()].push_back(opt.default_value());
-      opt.found(true);
-    }
+void OptionParser::warn_if_deprecated(const std::string &flag,
+                                      unsigned int idx) {
+  if (m_deprecated_flags.empty()) {
+    return;
   }
-  if (!missing.empty()) {
-    throw fail_for_missing_arguments(missing);
+  auto deprecated = m_deprecated_flags.find(flag);
+  if (deprecated == m_deprecated_flags.end() || deprecated->second) {
+    return;
+  }
+  deprecated->second = true;
+  auto &opt = m_options[idx];
+  std::cerr << "Warning: flag '" << flag << "' is deprecated";
+  for (const auto *replacement : {&opt.long_flag(), &opt.short_flag()}) {
+    if (!replacement->empty()) {
+      std::cerr << ", use '" << *replacement << "' instead";
+      break;
+    }
   }
+  std::cerr << "." << std::endl;
 }
 
-void OptionParser::eat_arguments(unsigned int argc, char const *argv[]) {
-  unsigned int idx_ctr = 0;
-  for (auto &opt : m_options) {
-    m_option_idx[opt.dest()] = idx_ctr;
-    idx_ctr++;
+// Resolves an abbreviated long flag. Flags starting with `prefix` form a
+// contiguous run of m_long_flags; the prefix resolves if they all belong to
+// the same option, and is reported as ambiguous otherwise.
+std::unordered_map<std::string, unsigned int>::iterator
+OptionParser::find_abbreviation(const std::string &prefix) {
+  auto range = long_flags_starting_with(prefix);
+  auto first = range.first;
+  auto last = range.second;
+  if (first == last) {
+    return m_flag_idx.end();
   }
+  bool ambiguous = std::any_of(
+      first, last, [first](const std::pair<std::string, unsigned int> &flag) {
+        return flag.second != first->second;
+      });
+  if (ambiguous) {
+    auto msg = "Ambiguous option '" + prefix + "' could match";
+    for (auto candidate = first; candidate != last; ++candidate) {
+      msg += (candidate == first ? " " : ", ") + candidate->first;
+    }
+    try_to_exit_with_message(msg);
+    throw ParserError(msg);
+  }
+  // The prefix was not typed as a deprecated alias unless it only matches
+  // deprecated aliases.
+  auto match = std::find_if(
+      first, last, [this](const std::pair<std::string, unsigned int> &flag) {
+        return !m_deprecated_flags.count(flag.first);
+      });
+  return m_flag_idx.find(match != last ? match->first : first->first);
+}
 
-  const std::string args_end = "- ";
-  m_prog_name = argv[0];
-  std::vector<std::string> arguments(argv + 1, argv + argc);
-
-  // dummy way to solve problem with last arg of
-  arguments.emplace_back(args_end);
-
-  // for each argument cluster
-  int pos_args = 1;
-  for (unsigned int arg = 0; arg < arguments.size(); ++arg) {
-    bool match_found = false;
-    // for each option sets
-    for (auto &option : m_options) {
-      match_found = try_to_get_opt(arguments, arg, option, option.long_flag());
-      if (match_found) {
-        break;
-      }
+std::pair<std::vector<std::pair<std::string, unsigned int>>::iterator,
+          std::vector<std::pair<std::string, unsigned int>>::iterator>
+OptionParser::long_flags_starting_with(const std::string &prefix) {
+  auto first = std::lower_bound(
+      m_long_flags.begin(), m_long_flags.end(), prefix,
+      [](const std::pair<std::string, unsigned int> &flag,
+         const std::string &p) { return flag.first < p; });
+  auto last = first;
+  while (last != m_long_flags.end() &&
+         last->first.compare(0, prefix.size(), prefix) == 0) {
+    ++last;
+  }
+  return {first, last};
+}
 
-      match_found = try_to_get_opt(arguments, arg, option, option.short_flag());
-      if (match_found) {
-        break;
-      }
+// Whether `argument` is a POSIX-style cluster of short flags such as "-vvx"
+// or "-n5": every character up to the first value-taking flag names a short
+// flag, and whatever follows that flag is its value.
+bool OptionParser::is_short_cluster(const char *argument) {
+  if (argument[0] != '-' || argument[1] == '-' || argument[1] == '\0' ||
+      argument[2] == '\0') {
+    return false;
+  }
+  for (const char *c = argument + 1; *c; ++c) {
+    auto slot = m_short_idx[static_cast<unsigned char>(*c)];
+    if (!slot) {
+      return false;
     }
+    auto &opt = m_options[slot - 1];
+    if (opt.mode() != STORE_TRUE) {
+      return !opt.found() || opt.mode() == STORE_MAP;
+    }
+  }
+  return true;
+}
 
-    if (!match_found) {
-      if (arguments[arg] != args_end) {
-        if (m_pos_args_count > pos_args) {
-          m_options[m_option_idx.at(m_positional_options_names[pos_args - 1])]
-              .found(true);
-          m_values[m_positional_options_names[pos_args - 1]].push_back(
-              arguments[arg]);
-          pos_args++;
-        } else
-          throw fail_unrecognized_argument(arguments[arg]);
-      }
+std::size_t OptionParser::feed_short_cluster(const char *argument) {
+  std::size_t completed = 0;
+  for (const char *c = argument + 1; *c; ++c) {
+    unsigned int idx = m_short_idx[static_cast<unsigned char>(*c)] - 1;
+    auto &opt = m_options[idx];
+    if (!m_deprecated_flags.empty()) {
+      warn_if_deprecated(std::string{'-', *c}, idx);
+    }
+    if (opt.mode() == STORE_TRUE) {
+      opt.found(true);
+      store_value(idx, nullptr);
+      ++completed;
+      continue;
+    }
+    if (!m_events && !opt.found()) {
+      m_values[opt.dest()].clear();
+    }
+    m_pending = idx;
+    m_pending_values = 0;
+    m_pending_flag = opt.short_flag();
+    if (c[1]) {
+      store_value(idx, c + 1);
+      ++m_pending_values;
+      completed += finish_pending();
     }
+    break;
   }
+  return completed;
+}
 
-  if (get_value("help")) {
-    help();
+std::size_t OptionParser::finish_pending() {
+  unsigned int idx = m_pending;
+  auto &opt = m_options[idx];
+  m_pending = -1;
+  if (!m_pending_values) {
+    if (!opt.has_default()) {
+      auto msg = "error, flag '" + m_pending_flag + "' requires an argument.";
+      try_to_exit_with_message(msg);
+      throw ParserError(msg);
+    }
+    store_value(idx, opt.default_value().c_str());
   }
-  check_for_missing_args();
+  opt.found(true);
+  return 1;
 }
 
-void OptionParser::try_to_exit_with_message(const std::string &e) {
-  if (m_exit_on_failure) {
-    std::cerr << "In excecutable \'";
-    std::cerr << m_prog_name << "\':\n" << e << std::endl;
-    exit(1);
+void OptionParser::store_value(unsigned int idx, const char *value) {
+  auto &opt = m_options[idx];
+  if (value && opt.mode() == STORE_MAP && !std::strchr(value, '=')) {
+    auto msg = "error, '" + opt.dest() + "' expects key=value, got '" +
+               value + "'.";
+    try_to_exit_with_message(msg);
+    throw ParserError(msg);
+  }
+  if (value && opt.choices() && !opt.choices()->values.count(value)) {
+    throw fail_invalid_choice(opt, value);
+  }
+  if (m_events) {
+    m_events->push_back(ParseEvent{&opt, value});
+    if (value && opt.path_checks()) {
+      m_event_paths.emplace_back(idx, value);
+    }
+  } else if (value) {
+    auto &values = m_values[opt.dest()];
+    values.push_back(value);
+    if (opt.mode() == STORE_MAP) {
+      index_map_entry(opt.dest(), values);
+    }
   }
 }
 
-ParserError OptionParser::fail_for_missing_key(const std::string &key) {
-  auto msg = "Tried to access value for field '" + key +
-             "' which is not a valid field.";
-  try_to_exit_with_message(msg);
-  return ParserError(msg);
+void OptionParser::index_map_entry(const std::string &dest,
+                                   const std::vector<std::string> &values) {
+  auto entry = static_cast<unsigned int>(values.size() - 1);
+  m_maps[dest].insert(values, entry, values.back().find('='));
 }
 
-ParserError OptionParser::fail_unrecognized_argument(const std::string &arg) {
-  auto msg = "Unrecognized flag/option '" + arg + "'";
-  try_to_exit_with_message(msg);
-  return ParserError(msg);
+const char *OptionParser::get_map_value(const std::string &key,
+                                        const std::string &map_key) {
+  auto map = m_maps.find(key);
+  if (map == m_maps.end()) {
+    auto idx = m_option_idx.find(key);
+    if (idx == m_option_idx.end()) {
+      throw fail_for_missing_key(key);
+    }
+    // Not given: the default entry, if any.
+    auto &entry = m_options[idx->second].default_value();
+    if (entry.size() > map_key.size() && entry[map_key.size()] == '=' &&
+        entry.compare(0, map_key.size(), map_key) == 0) {
+      return entry.c_str() + map_key.size() + 1;
+    }
+    return nullptr;
+  }
+  auto &values = m_values[key];
+  auto entry = map->second.find(values, map_key.data(), map_key.size());
+  if (entry < 0) {
+    return nullptr;
+  }
+  return values[entry].c_str() + map_key.size() + 1;
 }
 
-ParserError OptionParser::fail_for_missing_arguments(
-    const std::vector<std::string> &missing_flags) {
-  auto msg =
+const std::vector<std::string> *
+OptionParser::stored_values(const std::string &key, Option *&option) {
+  auto idx = m_option_idx.find(key);
+  if (idx == m_option_idx.end()) {
+    throw fail_for_missing_key(key);
+  }
+  option = &m_options[idx->second];
+  auto values = m_values.find(key);
+  if (values != m_values.end() && !values->second.empty()) {
+    return &values->second;
+  }
+  if (!option->has_default()) {
+    throw fail_for_missing_key(key);
+  }
+  return nullptr;
+}
+
+// Builds the parser of a subcommand, sharing our leniency settings.
+std::shared_ptr<OptionParser>
+OptionParser::make_subparser(unsigned int subcommand_idx) {
+  auto &subcommand = m_subcommands[subcommand_idx];
+#ifndef OPTIONPARSER_NO_HELP
+  auto subparser = std::make_shared<OptionParser>(subcommand.help);
+#else
+  auto subparser = std::make_shared<OptionParser>();
+#endif
+  subparser->m_exit_on_failure = m_exit_on_failure;
+  subparser->m_allow_abbrev = m_allow_abbrev;
+  subcommand.factory(*subparser);
+  return subparser;
+}
+
+std::size_t OptionParser::feed_subparser(const char *argument) {
+  // The subparser reports through our event queue and leniency settings.
+  m_subparser->m_events = m_events;
+  m_subparser->m_allow_unknown = m_allow_unknown;
+  auto completed = m_subparser->feed(argument);
+  m_subparser->m_events = nullptr;
+  m_unrecognized = m_subparser->m_unrecognized;
+  m_options_ended = m_subparser->m_options_ended;
+  return completed;
+}
+
+void OptionParser::end_arguments() {
+  if (m_pending >= 0) {
+    finish_pending();
+  }
+  auto help_idx = m_option_idx.find("help");
+  if (help_idx != m_option_idx.end() && m_options[help_idx->second].found()) {
+    help();
+  }
+  if (m_subparser) {
+    m_subparser->m_events = m_events;
+    m_subparser->end_arguments();
+    m_subparser->m_events = nullptr;
+  }
+  if (m_constraints.empty()) {
+    check_for_missing_args();
+  } else {
+    // Taken before defaults mark their options as found.
+    utils::Bitset given(m_options.size());
+    for (unsigned int idx = 0; idx < m_options.size(); ++idx) {
+      if (m_options[idx].found()) {
+        given.set(idx);
+      }
+    }
+    check_for_missing_args();
+    check_constraints(given);
+  }
+  check_paths();
+}
+
+// Path checks can take a while each (think cold network file systems), so
+// all values of all options are checked concurrently, and every failure
+// is reported in one go.
+void OptionParser::check_paths() {
+  std::vector<std::pair<Option *, const std::string *>> paths;
+  std::vector<bool> given(m_options.size());
+  for (const auto &path : m_event_paths) {
+    paths.emplace_back(&m_options[path.first], &path.second);
+    given[path.first] = true;
+  }
+  for (unsigned int idx = 0; idx < m_options.size(); ++idx) {
+    auto &opt = m_options[idx];
+    if (!opt.path_checks() || given[idx]) {
+      continue;
+    }
+    auto values = m_values.find(opt.dest());
+    if (values != m_values.end() && !values->second.empty()) {
+      for (const auto &value : values->second) {
+        paths.emplace_back(&opt, &value);
+      }
+    } else if (opt.has_default()) {
+      paths.emplace_back(&opt, &opt.default_value());
+    }
+  }
+  if (paths.empty()) {
+    return;
+  }
+  std::vector<const char *> failures(paths.size());
+  auto threads = std::min<std::size_t>(
+      paths.size(), std::max(8u, 2 * std::thread::hardware_concurrency()));
+  utils::parallel_for(paths.size(), threads,
+                      [&paths, &failures](std::size_t i) {
+                        failures[i] = utils::check_path(
+                            *paths[i].second, paths[i].first->path_checks());
+                      });
+  std::string msg;
+  for (std::size_t i = 0; i < paths.size(); ++i) {
+    if (failures[i]) {
+      msg += (msg.empty() ? "Invalid paths: " : "; ") +
+             flag_name(*paths[i].first) + " '" + *paths[i].second + "' " +
+             failures[i];
+    }
+  }
+  if (!msg.empty()) {
+    msg += ".";
+    try_to_exit_with_message(msg);
+    throw ParserError(msg);
+  }
+}
+
+OptionParser &
+OptionParser::exactly_one_of(const std::vector<std::string> &dests) {
+  return add_constraint(Constraint::EXACTLY_ONE, 1, "", dests);
+}
+
+OptionParser &
+OptionParser::at_most_one_of(const std::vector<std::string> &dests) {
+  return add_constraint(Constraint::AT_MOST_ONE, 1, "", dests);
+}
+
+OptionParser &OptionParser::at_least(std::size_t count,
+                                     const std::vector<std::string> &dests) {
+  return add_constraint(Constraint::AT_LEAST, count, "", dests);
+}
+
+OptionParser &
+OptionParser::requires_options(const std::string &dest,
+                               const std::vector<std::string> &required) {
+  return add_constraint(Constraint::REQUIRES, 0, dest, required);
+}
+
+OptionParser &
+OptionParser::add_constraint(Constraint::Kind kind, std::size_t count,
+                             const std::string &subject,
+                             const std::vector<std::string> &dests) {
+  m_constraints.push_back(
+      Constraint{kind, count, subject, dests, 0, utils::Bitset()});
+  return *this;
+}
+
+void OptionParser::compile_constraints() {
+  auto lookup = [this](const std::string &dest) {
+    auto idx = m_option_idx.find(dest);
+    if (idx == m_option_idx.end()) {
+      auto msg = "Parser inconsistency: constraint on unknown option '" +
+                 dest + "'.";
+      try_to_exit_with_message(msg);
+      throw std::runtime_error(msg);
+    }
+    return idx->second;
+  };
+  for (auto &constraint : m_constraints) {
+    constraint.mask = utils::Bitset(m_options.size());
+    for (const auto &dest : constraint.dests) {
+      constraint.mask.set(lookup(dest));
+    }
+    if (constraint.kind == Constraint::REQUIRES) {
+      constraint.subject_idx = lookup(constraint.subject);
+    }
+  }
+}
+
+void OptionParser::check_constraints(const utils::Bitset &given) {
+  std::vector<std::string> violations;
+  for (auto &constraint : m_constraints) {
+    bool ok;
+    switch (constraint.kind) {
+    case Constraint::EXACTLY_ONE:
+      ok = given.count_common(constraint.mask) == 1;
+      break;
+    case Constraint::AT_MOST_ONE:
+      ok = given.count_common(constraint.mask) <= 1;
+      break;
+    case Constraint::AT_LEAST:
+      ok = given.count_common(constraint.mask) >= constraint.count;
+      break;
+    default:
+      ok = !given.test(constraint.subject_idx) ||
+           given.contains(constraint.mask);
+    }
+    if (ok) {
+      continue;
+    }
+    // Only failures pay for building a message.
+    std::string names;
+    for (const auto &dest : constraint.dests) {
+      names += (names.empty() ? "" : ", ") +
+               flag_name(m_options[m_option_idx[dest]]);
+    }
+    switch (constraint.kind) {
+    case Constraint::EXACTLY_ONE:
+      violations.push_back("exactly one of " + names + " is required");
+      break;
+    case Constraint::AT_MOST_ONE:
+      violations.push_back("at most one of " + names + " is allowed");
+      break;
+    case Constraint::AT_LEAST:
+      violations.push_back("at least " + std::to_string(constraint.count) +
+                           " of " + names + " are required");
+      break;
+    default:
+      violations.push_back(flag_name(m_options[constraint.subject_idx]) +
+                           " requires " + names);
+    }
+  }
+  if (!violations.empty()) {
+    auto msg = "Invalid combination of flags: " +
+               std::accumulate(violations.begin() + 1, violations.end(),
+                               violations.front(),
+                               [](const std::string &s,
+                                  const std::string &piece) -> std::string {
+                                 return s + "; " + piece;
+                               }) +
+               ".";
+    try_to_exit_with_message(msg);
+    throw ParserError(msg);
+  }
+}
+
+std::string OptionParser::flag_name(Option &option) {
+  for (const auto *flag :
+       {&option.long_flag(), &option.short_flag(), &option.pos_flag()}) {
+    if (!flag->empty()) {
+      return *flag;
+    }
+  }
+  return option.dest();
+}
+
+OptionParser &
+OptionParser::add_subcommand(const std::string &name,
+                             std::function<void(OptionParser &)> factory,
+                             const std::string &help) {
+  if (!m_subcommand_idx.emplace(name, m_subcommands.size()).second) {
+    auto msg = "Parser inconsistency: subcommand '" + name +
+               "' is already registered.";
+    try_to_exit_with_message(msg);
+    throw ParserError(msg);
+  }
+  Subcommand subcommand;
+  subcommand.name = name;
+#ifndef OPTIONPARSER_NO_HELP
+  subcommand.help = help;
+#else
+  (void)help;
+#endif
+  subcommand.factory = std::move(factory);
+  m_subcommands.push_back(std::move(subcommand));
+  return *this;
+}
+
+OptionParser &OptionParser::subparser() {
+  if (!m_subparser) {
+    auto msg = std::string("No subcommand was selected.");
+    try_to_exit_with_message(msg);
+    throw ParserError(msg);
+  }
+  return *m_subparser;
+}
+
+void OptionParser::parse_command_line(const std::string &command) {
+  m_command_line = command;
+  std::vector<const char *> tokens;
+  if (auto error = utils::tokenize_command_line(m_command_line, tokens)) {
+    auto msg = "Malformed command line: " + std::string(error) + ".";
+    try_to_exit_with_message(msg);
+    throw ParserError(msg);
+  }
+  eat_arguments(tokens.begin(), tokens.end());
+}
+
+// Runs on every keystroke, so the words before the one being completed are
+// only walked far enough to know which option (or positional) takes it.
+std::vector<std::string>
+OptionParser::complete(const std::vector<std::string> &words,
+                       std::size_t index) {
+  if (schema_revision() != m_index_revision) {
+    build_index();
+  }
+  index = std::min(index, words.size());
+  int pending = -1;
+  bool ended = false;
+  std::size_t positionals = 0;
+  for (std::size_t i = 1; i < index; ++i) {
+    const auto &word = words[i];
+    bool is_flag = !ended && word.size() > 1 && word[0] == '-';
+    if (pending >= 0 && !is_flag) {
+      if (m_options[pending].mode() != STORE_MULT_VALUES) {
+        pending = -1;
+      }
+      continue;
+    }
+    pending = -1;
+    if (!is_flag) {
+      auto sub = ended ? m_subcommand_idx.end() : m_subcommand_idx.find(word);
+      if (sub != m_subcommand_idx.end()) {
+        return make_subparser(sub->second)->complete(
+            std::vector<std::string>(words.begin() + i, words.end()),
+            index - i);
+      }
+      ++positionals;
+    } else if (word == "--") {
+      ended = true;
+    } else if (word[1] == '-') {
+      if (word.find('=') == std::string::npos) {
+        pending = completed_flag(word);
+      }
+    } else {
+      // A cluster of short flags; the first one taking a value takes the
+      // rest of the word, or the next word.
+      for (std::size_t c = 1; c < word.size(); ++c) {
+        auto slot = m_short_idx[static_cast<unsigned char>(word[c])];
+        if (!slot) {
+          break;
+        }
+        if (m_options[slot - 1].mode() != STORE_TRUE) {
+          if (c + 1 == word.size()) {
+            pending = static_cast<int>(slot - 1);
+          }
+          break;
+        }
+      }
+    }
+    if (pending >= 0 && m_options[pending].mode() == STORE_TRUE) {
+      pending = -1;
+    }
+  }
+
+  std::vector<std::string> candidates;
+  const std::string current = index < words.size() ? words[index] : "";
+  bool is_flag = !ended && !current.empty() && current[0] == '-';
+  if (pending >= 0 && !is_flag) {
+    complete_value(m_options[pending], current, candidates);
+    return candidates;
+  }
+  if (is_flag) {
+    auto eq = current.find('=');
+    if (eq != std::string::npos && current[1] == '-') {
+      auto idx = completed_flag(current.substr(0, eq));
+      if (idx >= 0 && m_options[idx].mode() != STORE_TRUE) {
+        complete_value(m_options[idx], current.substr(eq + 1), candidates,
+                       current.substr(0, eq + 1));
+      }
+      return candidates;
+    }
+    for (auto &option : m_options) {
+      for (const auto *flag : {&option.long_flag(), &option.short_flag()}) {
+        if (!flag->empty() && flag->compare(0, current.size(), current) == 0) {
+          candidates.push_back(*flag);
+        }
+      }
+      for (const auto &alias : option.aliases()) {
+        if (!alias.deprecated &&
+            alias.flag.compare(0, current.size(), current) == 0) {
+          candidates.push_back(alias.flag);
+        }
+      }
+    }
+    return candidates;
+  }
+  if (!ended) {
+    for (const auto &subcommand : m_subcommands) {
+      if (subcommand.name.compare(0, current.size(), current) == 0) {
+        candidates.push_back(subcommand.name);
+      }
+    }
+  }
+  if (positionals < m_positional_idx.size()) {
+    complete_value(m_options[m_positional_idx[positionals]], current,
+                   candidates);
+  }
+  return candidates;
+}
+
+// The option named by a complete or abbreviated flag, or -1 for unknown and
+// ambiguous ones.
+int OptionParser::completed_flag(const std::string &flag) {
+  auto exact = m_flag_idx.find(flag);
+  if (exact != m_flag_idx.end()) {
+    return static_cast<int>(exact->second);
+  }
+  if (!m_allow_abbrev || flag.size() <= 2 || flag[1] != '-') {
+    return -1;
+  }
+  auto range = long_flags_starting_with(flag);
+  if (range.first == range.second ||
+      std::any_of(range.first, range.second,
+                  [&range](const std::pair<std::string, unsigned int> &f) {
+                    return f.second != range.first->second;
+                  })) {
+    return -1;
+  }
+  return static_cast<int>(range.first->second);
+}
+
+void OptionParser::complete_value(Option &option, const std::string &prefix,
+                                  std::vector<std::string> &candidates,
+                                  const std::string &leading) {
+  std::vector<std::string> computed;
+  const std::vector<std::string> *values = nullptr;
+  if (option.completer()) {
+    computed = option.completer()(prefix);
+    values = &computed;
+  } else if (option.choices()) {
+    values = &option.choices()->names;
+  } else {
+    return;
+  }
+  for (const auto &value : *values) {
+    if (value.compare(0, prefix.size(), prefix) == 0) {
+      candidates.push_back(leading + value);
+    }
+  }
+}
+
+void OptionParser::print_completions(const std::vector<std::string> &request) {
+  if (!request.empty()) {
+    char *end = nullptr;
+    auto index = std::strtoul(request[0].c_str(), &end, 10);
+    if (end != request[0].c_str() && *end == '\0') {
+      auto candidates = complete(
+          std::vector<std::string>(request.begin() + 1, request.end()), index);
+      std::string out;
+      for (const auto &candidate : candidates) {
+        out += candidate;
+        out += '\n';
+      }
+      std::cout << out << std::flush;
+    }
+  }
+  exit(0);
+}
+
+std::vector<char const *>
+OptionParser::parse_known_args(unsigned int argc, char const *argv[]) {
+  auto unknown = parse_known_args(argv, argv + argc);
+  std::vector<char const *> arguments;
+  arguments.reserve(unknown.size());
+  for (auto arg : unknown) {
+    arguments.push_back(*arg);
+  }
+  return arguments;
+}
+
+template <class Iterator>
+std::vector<Iterator> OptionParser::parse_known_args(Iterator first,
+                                                     Iterator last) {
+  std::vector<Iterator> unknown;
+  if (first == last) {
+    begin_arguments();
+  } else {
+    utils::assign_str(m_element, *first, 0);
+    begin_arguments(m_element);
+    ++first;
+  }
+  m_allow_unknown = true;
+  try {
+    for (; first != last && !m_options_ended; ++first) {
+      feed_element(*first);
+      if (m_unrecognized) {
+        unknown.push_back(first);
+      }
+    }
+  } catch (...) {
+    m_allow_unknown = false;
+    throw;
+  }
+  m_allow_unknown = false;
+  for (; first != last; ++first) {
+    unknown.push_back(first);
+  }
+  end_arguments();
+  return unknown;
+}
+
+ArgumentReader<char const **>
+OptionParser::read_arguments(unsigned int argc, char const *argv[]) {
+  return ArgumentReader<char const **>(*this, argv, argv + argc);
+}
+
+template <class Iterator>
+ArgumentReader<Iterator> OptionParser::read_arguments(Iterator first,
+                                                      Iterator last) {
+  return ArgumentReader<Iterator>(*this, first, last);
+}
+
+void OptionParser::try_to_exit_with_message(const std::string &e) {
+  if (m_exit_on_failure) {
+    std::cerr << "In excecutable \'";
+    std::cerr << m_prog_name << "\':\n" << e << std::endl;
+    exit(1);
+  }
+}
+
+ParserError OptionParser::fail_for_missing_key(const std::string &key) {
+  auto msg = "Tried to access value for field '" + key +
+             "' which is not a valid field.";
+  try_to_exit_with_message(msg);
+  return ParserError(msg);
+}
+
+ParserError OptionParser::fail_unrecognized_argument(const std::string &arg) {
+  auto msg = "Unrecognized flag/option '" + arg + "'";
+  auto suggestions = suggest(arg);
+  for (std::size_t i = 0; i < suggestions.size(); ++i) {
+    msg += (i == 0 ? ", did you mean '" : "' or '") + suggestions[i];
+  }
+  if (!suggestions.empty()) {
+    msg += "'?";
+  }
+  try_to_exit_with_message(msg);
+  return ParserError(msg);
+}
+
+ParserError OptionParser::fail_invalid_choice(Option &option,
+                                              const std::string &value) {
+  auto closest = utils::nearest(value, option.choices()->names, 3);
+  auto msg = "error, invalid choice '" + value + "' for '" +
+             flag_name(option) + "'";
+  for (std::size_t i = 0; i < closest.size(); ++i) {
+    msg += (i == 0 ? ", closest choices: " : ", ") + closest[i];
+  }
+  msg += ".";
+  try_to_exit_with_message(msg);
+  return ParserError(msg);
+}
+
+long long OptionParser::choice_value(Option &option, const std::string &value) {
+  if (!option.choices()) {
+    auto msg = "error, '" + option.dest() + "' has no choices.";
+    try_to_exit_with_message(msg);
+    throw ParserError(msg);
+  }
+  auto choice = option.choices()->values.find(value);
+  if (choice == option.choices()->values.end()) {
+    throw fail_invalid_choice(option, value);
+  }
+  return choice->second;
+}
+
+ParserError OptionParser::fail_for_missing_arguments(
+    const std::vector<std::string> &missing_flags) {
+  auto msg =
       "Missing required flags: " +
       std::accumulate(
           missing_flags.begin() + 1, missing_flags.end(), missing_flags.at(0),
-          [](std::string &s, const std::string &piece) -> std::string {
+          [](const std::string &s, const std::string &piece) -> std::string {
             return s + ", " + piece;
           }) +
       ".";
@@ -576,55 +2795,690 @@ ParserError OptionParser::fail_for_missing_arguments(
   return ParserError(msg);
 }
 
-void OptionParser::help() {
-  auto split = m_prog_name.find_last_of('/');
-  std::stringstream leading;
+#ifndef OPTIONPARSER_NO_HELP
+const std::string &OptionParser::help_text() {
+  auto revision = schema_revision();
+  if (!m_help_cache.empty() && m_help_cache_revision == revision &&
+      m_help_cache_prog_name == m_prog_name) {
+    return m_help_cache;
+  }
 
-  leading << "usage: " << m_prog_name.substr(split + 1) << " ";
-  std::string usage_str = leading.str();
-  std::cout << usage_str;
+  std::string &text = m_help_cache;
+  text.clear();
 
-  std::vector<std::string> option_usage;
+  text += "usage: " + short_prog_name() + " ";
+  auto usage_width = utils::display_width(text);
+  utils::TextWrapper wrapper(text, utils::layout_width(80, usage_width + 20),
+                             std::string(usage_width, ' '), usage_width);
   for (auto &option : m_options) {
-    std::stringstream optss;
-    optss << (option.required() ? "" : "[");
-    if (!option.short_flag().empty()) {
-      optss << option.short_flag();
-    } else if (!option.long_flag().empty()) {
-      optss << option.long_flag();
+    wrapper.word(option_usage(option));
+  }
+  if (!m_subcommands.empty()) {
+    wrapper.word("COMMAND ...");
+  }
+  text += '\n';
+
+  if (!m_description.empty()) {
+    text += "\n" + m_description + "\n\n";
+  }
+
+  bool has_positional = false;
+  for (auto &option : m_options) {
+    if (!option.pos_flag().empty()) {
+      if (!has_positional) {
+        text += "\nPositional Arguments:\n";
+        has_positional = true;
+      }
+      text += option.help_doc();
+    }
+  }
+
+  text += "\nOptions:\n";
+  for (auto &option : m_options) {
+    if (option.pos_flag().empty()) {
+      text += option.help_doc();
+    }
+  }
+
+  if (!m_subcommands.empty()) {
+    text += "\nCommands:\n";
+    for (auto &subcommand : m_subcommands) {
+      auto line = "    " + subcommand.name;
+      auto column = std::max(utils::display_width(line) + 1,
+                             static_cast<std::size_t>(25));
+      line.resize(line.size() + column - utils::display_width(line), ' ');
+      utils::TextWrapper wrapper(line,
+                                 utils::layout_width(column + 50, column + 20),
+                                 std::string(column, ' '), column);
+      wrapper.words(subcommand.help);
+      text += line + '\n';
+    }
+  }
+
+  m_help_cache_revision = revision;
+  m_help_cache_prog_name = m_prog_name;
+  return text;
+}
+
+std::string OptionParser::option_usage(Option &option) {
+  std::string usage = option.required() ? "" : "[";
+  if (!option.short_flag().empty()) {
+    usage += option.short_flag();
+  } else if (!option.long_flag().empty()) {
+    usage += option.long_flag();
+  }
+  if (!option.pos_flag().empty()) {
+    usage += option.metavar();
+  } else if (option.mode() != StorageMode::STORE_TRUE) {
+    usage += " " + option.metavar();
+  }
+  usage += option.required() ? " " : "] ";
+  return usage;
+}
+
+std::string OptionParser::short_prog_name() {
+  return m_prog_name.substr(m_prog_name.find_last_of('/') + 1);
+}
+
+std::string OptionParser::man_page() {
+  // Escape text for troff: backslashes and dashes, and a leading '.' or '\''
+  // which would otherwise start a request.
+  auto escape = [](const std::string &in) {
+    std::string out;
+    if (!in.empty() && (in[0] == '.' || in[0] == '\'')) {
+      out += "\\&";
     }
-    if (option.mode() != StorageMode::STORE_TRUE) {
-      optss << (option.pos_flag().empty() ? " " : "") << option.metavar();
+    for (char c : in) {
+      if (c == '\\' || c == '-') {
+        out += '\\';
+      }
+      out += c;
+    }
+    return out;
+  };
+  auto name = short_prog_name();
+  std::string upper = name;
+  std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+
+  std::string page = ".TH \"" + escape(upper) + "\" 1\n.SH NAME\n" +
+                     escape(name) +
+                     (m_description.empty() ? "" : " \\- " +
+                                                       escape(m_description)) +
+                     "\n.SH SYNOPSIS\n.B " + escape(name) + "\n";
+  for (auto &option : m_options) {
+    auto usage = option_usage(option);
+    page += escape(usage.substr(0, usage.find_last_not_of(' ') + 1)) + "\n";
+  }
+  if (!m_description.empty()) {
+    page += ".SH DESCRIPTION\n" + escape(m_description) + "\n";
+  }
+
+  for (int positional = 1; positional >= 0; --positional) {
+    bool header = false;
+    for (auto &option : m_options) {
+      if (option.pos_flag().empty() == static_cast<bool>(positional)) {
+        continue;
+      }
+      if (!header) {
+        page += positional ? ".SH ARGUMENTS\n" : ".SH OPTIONS\n";
+        header = true;
+      }
+      std::string flags;
+      for (const auto *flag :
+           {&option.long_flag(), &option.short_flag(), &option.pos_flag()}) {
+        if (!flag->empty()) {
+          flags += (flags.empty() ? "\\fB" : "\\fR, \\fB") + escape(*flag);
+        }
+      }
+      for (const auto &alias : option.aliases()) {
+        if (!alias.deprecated) {
+          flags += "\\fR, \\fB" + escape(alias.flag);
+        }
+      }
+      flags += "\\fR";
+      if (option.mode() != StorageMode::STORE_TRUE) {
+        flags += " \\fI" + escape(option.metavar()) + "\\fR";
+      }
+      page += ".TP\n" + flags + "\n" + escape(option.help()) + "\n";
     }
-    optss << (option.required() ? " " : "] ");
-    option_usage.emplace_back(optss.str());
   }
-  std::cout << utils::stitch_str(option_usage, 80,
-                                 std::string(usage_str.size(), ' '))
-                   .substr(usage_str.size())
-            << std::endl;
+  return page;
+}
 
+std::string OptionParser::markdown() {
+  auto name = short_prog_name();
+  std::string md = "# " + name + "\n\n";
   if (!m_description.empty()) {
-    std::cout << "\n" << m_description << "\n" << std::endl;
+    md += m_description + "\n\n";
+  }
+
+  md += "```\nusage: " + name + " ";
+  auto usage_width = name.size() + 8;
+  utils::TextWrapper wrapper(md, 80, std::string(usage_width, ' '),
+                             usage_width);
+  for (auto &option : m_options) {
+    auto usage = option_usage(option);
+    wrapper.word(usage.substr(0, usage.find_last_not_of(' ') + 1));
   }
+  md += "\n```\n";
 
-  std::vector<Option> pos_opts;
-  std::vector<Option> reg_opts;
-  std::copy_if(m_options.begin(), m_options.end(), std::back_inserter(pos_opts),
-               [](Option &o) { return !o.pos_flag().empty(); });
-  std::copy_if(m_options.begin(), m_options.end(), std::back_inserter(reg_opts),
-               [](Option &o) { return o.pos_flag().empty(); });
+  for (int positional = 1; positional >= 0; --positional) {
+    bool header = false;
+    for (auto &option : m_options) {
+      if (option.pos_flag().empty() == static_cast<bool>(positional)) {
+        continue;
+      }
+      if (!header) {
+        md += positional ? "\n## Positional Arguments\n\n"
+                         : "\n## Options\n\n";
+        header = true;
+      }
+      std::string flags;
+      for (const auto *flag :
+           {&option.long_flag(), &option.short_flag(), &option.pos_flag()}) {
+        if (!flag->empty()) {
+          flags += (flags.empty() ? "`" : "`, `") + *flag;
+        }
+      }
+      for (const auto &alias : option.aliases()) {
+        if (!alias.deprecated) {
+          flags += "`, `" + alias.flag;
+        }
+      }
+      if (option.mode() != StorageMode::STORE_TRUE) {
+        flags += " " + option.metavar();
+      }
+      md += "* " + flags + "`";
+      if (!option.help().empty()) {
+        md += ": " + option.help();
+      }
+      md += "\n";
+    }
+  }
+  return md;
+}
+
+std::string OptionParser::completion_script(const std::string &shell) {
+  if (shell == "bash") {
+    return bash_completion();
+  }
+  if (shell == "zsh") {
+    return zsh_completion();
+  }
+  if (shell == "fish") {
+    return fish_completion();
+  }
+  throw std::invalid_argument("No completion support for shell '" + shell +
+                              "'.");
+}
 
-  if (!pos_opts.empty()) {
-    std::cout << "\nPositional Arguments:" << std::endl;
-    std::for_each(pos_opts.begin(), pos_opts.end(),
-                  [](Option &o) { std::cout << o.help_doc(); });
+OptionParser::ValueHint OptionParser::value_hint(Option &option) {
+  if (option.pos_flag().empty() && option.mode() == STORE_TRUE) {
+    return NO_VALUE;
+  }
+  if (option.completer()) {
+    return DYNAMIC_VALUE;
+  }
+  if (option.choices()) {
+    return CHOICE_VALUE;
+  }
+  if (option.path_checks() & utils::PATH_IS_DIR) {
+    return DIR_VALUE;
   }
+  if (option.path_checks() || !option.pos_flag().empty()) {
+    return FILE_VALUE;
+  }
+  return ANY_VALUE;
+}
 
-  std::cout << "\nOptions:" << std::endl;
-  std::for_each(reg_opts.begin(), reg_opts.end(),
-                [](Option &o) { std::cout << o.help_doc(); });
+std::vector<std::string> OptionParser::documented_flags(Option &option) {
+  std::vector<std::string> flags;
+  for (const auto *flag : {&option.long_flag(), &option.short_flag()}) {
+    if (!flag->empty()) {
+      flags.push_back(*flag);
+    }
+  }
+  for (const auto &alias : option.aliases()) {
+    if (!alias.deprecated) {
+      flags.push_back(alias.flag);
+    }
+  }
+  return flags;
+}
+
+std::string OptionParser::completion_function() {
+  std::string function = "_";
+  for (char c : short_prog_name()) {
+    function += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+  }
+  return function + "_complete";
+}
+
+std::string OptionParser::bash_completion() {
+  auto quote = [](const std::string &in) {
+    std::string out = "'";
+    for (char c : in) {
+      out += c == '\'' ? std::string("'\\''") : std::string(1, c);
+    }
+    return out + "'";
+  };
+  // Word lists for compgen -W, which splits them on IFS (newlines, see
+  // below) and expands each word.
+  auto words = [&quote](const std::vector<std::string> &list) {
+    return quote(utils::shell_words(list, '\n'));
+  };
+  auto name = short_prog_name();
+  auto function = completion_function();
+  // Asks the program itself, for options with a completer.
+  const std::string query =
+      "COMPREPLY=($(\"${COMP_WORDS[0]}\" --__complete \"$COMP_CWORD\" "
+      "\"${COMP_WORDS[@]}\" 2>/dev/null))";
+
+  // Completes the current word against the options of `parser`, each line
+  // starting with `in`.
+  auto body = [&](OptionParser &parser, const std::string &in) {
+    std::string text = in + "case \"$prev\" in\n";
+    std::vector<std::string> all_flags;
+    // Completed for words that are not flags: the subcommands, else the
+    // first positional.
+    std::vector<std::string> positional_words;
+    auto positional_hint =
+        parser.m_subcommands.empty() ? ANY_VALUE : CHOICE_VALUE;
+    for (auto &option : parser.m_options) {
+      auto hint = parser.value_hint(option);
+      if (!option.pos_flag().empty()) {
+        if (positional_hint == ANY_VALUE) {
+          positional_hint = hint;
+          if (hint == CHOICE_VALUE) {
+            positional_words = option.choices()->names;
+          }
+        }
+        continue;
+      }
+      auto flags = parser.documented_flags(option);
+      all_flags.insert(all_flags.end(), flags.begin(), flags.end());
+      if (hint == NO_VALUE || flags.empty()) {
+        continue;
+      }
+      std::string pattern;
+      for (const auto &flag : flags) {
+        pattern += (pattern.empty() ? "" : "|") + flag;
+      }
+      text += in + "  " + pattern + ")\n" + in + "    ";
+      switch (hint) {
+      case CHOICE_VALUE:
+        text += "COMPREPLY=($(compgen -W " + words(option.choices()->names) +
+                " -- \"$cur\"))";
+        break;
+      case DIR_VALUE:
+        text += "COMPREPLY=($(compgen -d -- \"$cur\"))";
+        break;
+      case FILE_VALUE:
+        text += "COMPREPLY=($(compgen -f -- \"$cur\"))";
+        break;
+      case DYNAMIC_VALUE:
+        text += query;
+        break;
+      default:
+        text += "COMPREPLY=()";
+        break;
+      }
+      text += "\n" + in + "    return\n" + in + "    ;;\n";
+    }
+    for (const auto &subcommand : parser.m_subcommands) {
+      positional_words.push_back(subcommand.name);
+    }
+    text += in + "esac\n" + in + "if [[ \"$cur\" == -* ]]; then\n" + in +
+            "  COMPREPLY=($(compgen -W " + words(all_flags) +
+            " -- \"$cur\"))\n" + in + "else\n" + in + "  ";
+    if (!positional_words.empty()) {
+      text += "COMPREPLY=($(compgen -W " + words(positional_words) +
+              " -- \"$cur\"))";
+    } else if (positional_hint == DIR_VALUE) {
+      text += "COMPREPLY=($(compgen -d -- \"$cur\"))";
+    } else if (positional_hint == FILE_VALUE) {
+      text += "COMPREPLY=($(compgen -f -- \"$cur\"))";
+    } else if (positional_hint == DYNAMIC_VALUE) {
+      text += query;
+    } else {
+      text += "COMPREPLY=()";
+    }
+    return text + "\n" + in + "fi\n";
+  };
+
+  std::string script = "# bash completion for " + name +
+                       ", generated by optionparser.\n" + function +
+                       "() {\n"
+                       "  # Candidates, which may contain spaces, are one per "
+                       "line.\n"
+                       "  local IFS=$'\\n'\n"
+                       "  local cur=\"${COMP_WORDS[COMP_CWORD]}\"\n"
+                       "  local prev=\"${COMP_WORDS[COMP_CWORD-1]}\"\n";
+  if (m_subcommands.empty()) {
+    script += body(*this, "  ");
+  } else {
+    // Past a subcommand, the words are its own. Subcommands of subcommands
+    // only have their names completed.
+    std::string names;
+    for (const auto &subcommand : m_subcommands) {
+      names += (names.empty() ? "" : "|") +
+               utils::shell_words({subcommand.name});
+    }
+    script += "  local i command=\n"
+              "  for ((i = 1; i < COMP_CWORD; i++)); do\n"
+              "    case \"${COMP_WORDS[i]}\" in\n"
+              "      " +
+              names +
+              ")\n"
+              "        command=\"${COMP_WORDS[i]}\"\n"
+              "        break\n"
+              "        ;;\n"
+              "    esac\n"
+              "  done\n"
+              "  case \"$command\" in\n";
+    for (unsigned int i = 0; i < m_subcommands.size(); ++i) {
+      script += "    " + utils::shell_words({m_subcommands[i].name}) + ")\n" +
+                body(*make_subparser(i), "      ") + "      ;;\n";
+    }
+    script += "    *)\n" + body(*this, "      ") +
+              "      ;;\n"
+              "  esac\n";
+  }
+  script += "}\n"
+            "complete -F " +
+            function + " " + name + "\n";
+  return script;
+}
+
+std::string OptionParser::zsh_completion() {
+  // Inside single quotes, and within the brackets and colon-separated
+  // fields of an _arguments spec.
+  auto escape = [](const std::string &in) {
+    std::string out;
+    for (char c : in) {
+      if (c == '\'') {
+        out += "'\\''";
+        continue;
+      }
+      if (c == '[' || c == ']' || c == ':' || c == '\\') {
+        out += '\\';
+      }
+      out += c;
+    }
+    return out;
+  };
+  // Choices, split and unquoted by _arguments, inside single quotes.
+  auto items = [](const std::vector<std::string> &list) {
+    std::string out;
+    for (char c : utils::shell_words(list)) {
+      out += c == '\'' ? std::string("'\\''") : std::string(1, c);
+    }
+    return out;
+  };
+  auto action = [this, &items](OptionParser &parser,
+                               Option &option) -> std::string {
+    switch (parser.value_hint(option)) {
+    case CHOICE_VALUE:
+      return "(" + items(option.choices()->names) + ")";
+    case DIR_VALUE:
+      return "_files -/";
+    case FILE_VALUE:
+      return "_files";
+    case DYNAMIC_VALUE:
+      if (&parser != this) {
+        // Past a subcommand _arguments has dropped the words before it, so
+        // the program gets the ones saved below.
+        return "{compadd -- ${(f)\"$($all_words[1] --__complete "
+               "$((CURRENT-1+$#all_words-$#words)) \"${all_words[@]}\" "
+               "2>/dev/null)\"}}";
+      }
+      return "{compadd -- ${(f)\"$($words[1] --__complete $((CURRENT-1)) "
+             "\"${words[@]}\" 2>/dev/null)\"}}";
+    default:
+      return " ";
+    }
+  };
+  auto name = short_prog_name();
+  // The _arguments specs of `parser`, each on a line of its own starting
+  // with `in`. Words after a subcommand are completed with `rest`.
+  auto specs = [&](OptionParser &parser, const std::string &in,
+                   const std::string &rest) {
+    std::string text;
+    for (auto &option : parser.m_options) {
+      if (!option.pos_flag().empty()) {
+        continue;
+      }
+      auto flags = parser.documented_flags(option);
+      if (flags.empty()) {
+        continue;
+      }
+      auto spec = "[" + escape(option.help()) + "]";
+      if (parser.value_hint(option) != NO_VALUE) {
+        // Only the first word of the metavar of options taking many values.
+        auto metavar = option.metavar();
+        spec += ":" + escape(metavar.substr(0, metavar.find(' '))) + ":" +
+                action(parser, option);
+      }
+      auto repeat = option.mode() == STORE_MULT_VALUES ||
+                            option.mode() == STORE_MAP
+                        ? "*"
+                        : "";
+      if (flags.size() == 1) {
+        text += " \\\n" + in + "'" + std::string(repeat) + flags[0] + spec +
+                "'";
+      } else {
+        std::string group;
+        std::string braces;
+        for (const auto &flag : flags) {
+          group += (group.empty() ? "" : " ") + flag;
+          braces += (braces.empty() ? "" : ",") + std::string(repeat) + flag;
+        }
+        text += " \\\n" + in + "'(" + group + ")'{" + braces + "}'" + spec +
+                "'";
+      }
+    }
+    if (!parser.m_subcommands.empty()) {
+      std::vector<std::string> names;
+      for (const auto &subcommand : parser.m_subcommands) {
+        names.push_back(subcommand.name);
+      }
+      text += " \\\n" + in + "'1:command:(" + items(names) + ")' \\\n" + in +
+              "'*::argument:" + rest + "'";
+    } else {
+      for (auto &option : parser.m_options) {
+        if (!option.pos_flag().empty()) {
+          text += " \\\n" + in + "':" + escape(option.metavar()) + ":" +
+                  action(parser, option) + "'";
+        }
+      }
+    }
+    return text;
+  };
+
+  std::string script = "#compdef " + name + "\n# zsh completion for " + name +
+                       ", generated by optionparser.\n";
+  if (m_subcommands.empty()) {
+    return script + "_arguments -s" + specs(*this, "  ", "_files") + "\n";
+  }
+  // Past a subcommand, the words are its own. Subcommands of subcommands
+  // only have their names completed.
+  script += "local context state state_descr line\n"
+            "typeset -A opt_args\n"
+            "local -a all_words\n"
+            "all_words=(\"${words[@]}\")\n"
+            "_arguments -s -C" +
+            specs(*this, "  ", "->cmds") +
+            " && return\n"
+            "case $state in\n"
+            "  cmds)\n"
+            "    case $words[1] in\n";
+  for (unsigned int i = 0; i < m_subcommands.size(); ++i) {
+    script += "      " + utils::shell_words({m_subcommands[i].name}) +
+              ")\n"
+              "        _arguments -s" +
+              specs(*make_subparser(i), "          ", "_files") +
+              "\n"
+              "        ;;\n";
+  }
+  return script + "    esac\n"
+                  "    ;;\n"
+                  "esac\n";
+}
+
+std::string OptionParser::fish_completion() {
+  auto quote = [](const std::string &in) {
+    std::string out = "'";
+    for (char c : in) {
+      if (c == '\\' || c == '\'') {
+        out += '\\';
+      }
+      out += c;
+    }
+    return out + "'";
+  };
+  auto name = short_prog_name();
+  std::string script = "# fish completion for " + name +
+                       ", generated by optionparser.\n";
+  // Asks the program itself, for options with a completer.
+  auto query = "'(_" + completion_function() + ")'";
+  std::vector<std::shared_ptr<OptionParser>> subparsers;
+  for (unsigned int i = 0; i < m_subcommands.size(); ++i) {
+    subparsers.push_back(make_subparser(i));
+  }
+  auto has_completer = [](OptionParser &parser) {
+    for (auto &option : parser.m_options) {
+      if (option.completer()) {
+        return true;
+      }
+    }
+    return false;
+  };
+  bool dynamic = has_completer(*this);
+  for (auto &subparser : subparsers) {
+    dynamic = dynamic || has_completer(*subparser);
+  }
+  if (dynamic) {
+    script += "function _" + completion_function() +
+              "\n"
+              "  set -l words (commandline -opc) "
+              "(commandline -ct | string collect -a)\n"
+              "  $words[1] --__complete (math (count $words) - 1) $words "
+              "2>/dev/null\n"
+              "end\n";
+  }
+
+  // The completions of `parser`, each only where `condition` holds.
+  auto lines = [&](OptionParser &parser, const std::string &condition) {
+    auto command = "complete -c " + quote(name);
+    if (!condition.empty()) {
+      command += " -n " + quote(condition);
+    }
+    std::string text;
+    bool positional_files = false;
+    for (auto &option : parser.m_options) {
+      if (!option.pos_flag().empty()) {
+        auto hint = parser.value_hint(option);
+        if (hint == CHOICE_VALUE) {
+          text += command + " -f -a " +
+                  quote(utils::shell_words(option.choices()->names)) + "\n";
+        } else if (hint == DYNAMIC_VALUE) {
+          text += command + " -f -a " + query + "\n";
+        } else {
+          positional_files = true;
+        }
+        continue;
+      }
+      auto flags = parser.documented_flags(option);
+      if (flags.empty()) {
+        continue;
+      }
+      text += command;
+      for (const auto &flag : flags) {
+        if (flag[1] == '-') {
+          text += " -l " + quote(flag.substr(2));
+        } else {
+          text += " -s " + quote(flag.substr(1));
+        }
+      }
+      if (!option.help().empty()) {
+        text += " -d " + quote(option.help());
+      }
+      switch (parser.value_hint(option)) {
+      case CHOICE_VALUE:
+        text += " -x -a " + quote(utils::shell_words(option.choices()->names));
+        break;
+      case DIR_VALUE:
+        text += " -x -a '(__fish_complete_directories)'";
+        break;
+      case FILE_VALUE:
+        text += " -r -F";
+        break;
+      case DYNAMIC_VALUE:
+        text += " -x -a " + query;
+        break;
+      case ANY_VALUE:
+        text += " -x";
+        break;
+      default:
+        break;
+      }
+      text += "\n";
+    }
+    for (const auto &subcommand : parser.m_subcommands) {
+      text += command + " -f -a " +
+              quote(utils::shell_words({subcommand.name}));
+      if (!subcommand.help.empty()) {
+        text += " -d " + quote(subcommand.help);
+      }
+      text += "\n";
+    }
+    if (!positional_files && parser.m_subcommands.empty()) {
+      // Nothing takes files unless said so above.
+      text += command + " -f\n";
+    }
+    return text;
+  };
+
+  if (m_subcommands.empty()) {
+    return script + lines(*this, "");
+  }
+  // Past a subcommand, the words are its own. Subcommands of subcommands
+  // only have their names completed.
+  script += lines(*this, "__fish_use_subcommand");
+  for (unsigned int i = 0; i < m_subcommands.size(); ++i) {
+    script += lines(*subparsers[i],
+                    "__fish_seen_subcommand_from " +
+                        utils::shell_words({m_subcommands[i].name}));
+  }
+  return script;
+}
+
+#endif // OPTIONPARSER_NO_HELP
+
+void OptionParser::help() {
+  if (m_precomputed_help) {
+    std::fputs(m_precomputed_help, stdout);
+    exit(0);
+  }
+#ifndef OPTIONPARSER_NO_HELP
+  const std::string &text = help_text();
+  std::fwrite(text.data(), 1, text.size(), stdout);
   exit(0);
+#else
+  auto msg = std::string("No help is available in this build.");
+  try_to_exit_with_message(msg);
+  throw ParserError(msg);
+#endif
+}
+
+OptionParser &OptionParser::precomputed_help(const char *text) {
+  m_precomputed_help = text;
+  return *this;
+}
+
+OptionParser &OptionParser::prog_name(const std::string &name) {
+  m_prog_name = name;
+  return *this;
 }
 
 OptionParser &OptionParser::exit_on_failure(bool exit) {
@@ -637,6 +3491,55 @@ OptionParser &OptionParser::throw_on_failure(bool throw_) {
   return *this;
 }
 
+std::vector<std::string> OptionParser::suggest(const std::string &argument,
+                                               std::size_t max_suggestions) {
+  // Anything further away than a third of the argument is noise, as is a
+  // candidate that shares nothing but its dashes with it.
+  auto threshold = std::max<std::size_t>(1, (argument.size() + 1) / 3);
+  utils::EditDistance distance(argument);
+  std::vector<std::pair<std::size_t, const std::string *>> close;
+  auto consider = [&](const std::string &candidate, std::size_t dashes) {
+    if (candidate.empty()) {
+      return;
+    }
+    // The argument itself is no suggestion.
+    auto d = distance(candidate);
+    if (d > 0 && d <= threshold && d + dashes < candidate.size()) {
+      close.emplace_back(d, &candidate);
+    }
+  };
+  if (!argument.empty() && argument[0] == '-') {
+    for (auto &option : m_options) {
+      consider(option.long_flag(), 2);
+      consider(option.short_flag(), 1);
+      for (const auto &alias : option.aliases()) {
+        if (!alias.deprecated) {
+          consider(alias.flag, alias.flag[1] == '-' ? 2 : 1);
+        }
+      }
+    }
+  } else {
+    for (auto &subcommand : m_subcommands) {
+      consider(subcommand.name, 0);
+    }
+  }
+  std::stable_sort(close.begin(), close.end(),
+                   [](const std::pair<std::size_t, const std::string *> &a,
+                      const std::pair<std::size_t, const std::string *> &b) {
+                     return a.first < b.first;
+                   });
+  std::vector<std::string> suggestions;
+  for (std::size_t i = 0; i < close.size() && i < max_suggestions; ++i) {
+    suggestions.push_back(*close[i].second);
+  }
+  return suggestions;
+}
+
+OptionParser &OptionParser::allow_abbrev(bool allow) {
+  m_allow_abbrev = allow;
+  return *this;
+}
+
 template <class T> T OptionParser::get_value(const std::string &key) {
   try {
     return m_options[m_option_idx.at(key)].found();
@@ -645,51 +3548,177 @@ template <class T> T OptionParser::get_value(const std::string &key) {
   }
 }
 
-// Provide all template specializations for get_value<T>(keyName)
+// Scans each value for separators with memchr, and hands every decoded
+// element to `sink` along with its position in the list.
+template <class T, class Sink>
+std::size_t OptionParser::decode_list(const std::string &key, Sink sink) {
+  Option *option;
+  auto values = stored_values(key, option);
+  char separator = option->separator();
+  std::size_t count = 0;
+  auto first_value = values ? values->data() : &option->default_value();
+  auto last_value = values ? first_value + values->size() : first_value + 1;
+  for (auto value = first_value; value != last_value; ++value) {
+    const char *first = value->c_str();
+    const char *end = first + value->size();
+    while (true) {
+      auto last = separator ? static_cast<const char *>(
+                                  std::memchr(first, separator, end - first))
+                            : nullptr;
+      if (!last) {
+        last = end;
+      }
+      T element;
+      if (!utils::decode_element(first, last, element)) {
+        auto msg = "error, invalid element '" + std::string(first, last) +
+                   "' in the list for '" + key + "'.";
+        try_to_exit_with_message(msg);
+        throw ParserError(msg);
+      }
+      sink(count++, std::move(element));
+      if (last == end) {
+        break;
+      }
+      first = last + 1;
+    }
+  }
+  return count;
+}
+
+template <class T>
+std::vector<T> OptionParser::get_list(const std::string &key) {
+  std::vector<T> list;
+  auto values = m_values.find(key);
+  if (values != m_values.end()) {
+    std::size_t count = values->second.size();
+    char separator = m_options[m_option_idx.at(key)].separator();
+    if (separator) {
+      for (const auto &value : values->second) {
+        count += std::count(value.begin(), value.end(), separator);
+      }
+    }
+    list.reserve(count);
+  }
+  decode_list<T>(key, [&list](std::size_t, T &&element) {
+    list.push_back(std::move(element));
+  });
+  return list;
+}
+
+template <class T>
+std::size_t OptionParser::get_list(const std::string &key, T *out,
+                                   std::size_t capacity) {
+  return decode_list<T>(key, [out, capacity](std::size_t i, T &&element) {
+    if (i < capacity) {
+      out[i] = std::move(element);
+    }
+  });
+}
+
+template <class E> E OptionParser::get_choice(const std::string &key) {
+  Option *option;
+  auto values = stored_values(key, option);
+  auto &value = values ? values->front() : option->default_value();
+  return static_cast<E>(choice_value(*option, value));
+}
+
+template <class E>
+std::vector<E> OptionParser::get_choices(const std::string &key) {
+  Option *option;
+  auto values = stored_values(key, option);
+  std::vector<E> choices;
+  if (!values) {
+    choices.push_back(
+        static_cast<E>(choice_value(*option, option->default_value())));
+    return choices;
+  }
+  choices.reserve(values->size());
+  for (const auto &value : *values) {
+    choices.push_back(static_cast<E>(choice_value(*option, value)));
+  }
+  return choices;
+}
+
+// Provide all template specializations for get_value<T>(keyName). Values
+// come from the arguments if any were given and from the default otherwise.
 
 #define GET_VALUE_SPECIALIZE(type, code)                                       \
   template <> type OptionParser::get_value<type>(const std::string &key) {     \
     try {                                                                      \
+      Option *option;                                                          \
+      auto values = stored_values(key, option);                                \
       code                                                                     \
     } catch (std::out_of_range & err) {                                        \
       throw fail_for_missing_key(key);                                         \
     }                                                                          \
   }
 
-GET_VALUE_SPECIALIZE(std::string, { return m_values.at(key).at(0); })
+GET_VALUE_SPECIALIZE(std::string, {
+  return values ? values->front() : option->default_value();
+})
 
-GET_VALUE_SPECIALIZE(const char *, { return m_values.at(key).at(0).c_str(); })
+GET_VALUE_SPECIALIZE(const char *, {
+  return values ? values->front().c_str() : option->default_value().c_str();
+})
 
-GET_VALUE_SPECIALIZE(double, { return std::stod(m_values.at(key).at(0)); })
+GET_VALUE_SPECIALIZE(std::vector<std::string>, {
+  return values ? *values
+                : std::vector<std::string>(1, option->default_value());
+})
 
-GET_VALUE_SPECIALIZE(float, { return std::stof(m_values.at(key).at(0)); })
-
-GET_VALUE_SPECIALIZE(int, { return std::stoi(m_values.at(key).at(0)); })
-
-GET_VALUE_SPECIALIZE(unsigned int,
-                     { return std::stoul(m_values.at(key).at(0)); })
-
-GET_VALUE_SPECIALIZE(std::vector<std::string>, { return m_values.at(key); })
-
-#define GET_VALUE_SPECIALIZE_VECTOR(type, converter)                           \
+GET_VALUE_SPECIALIZE(std::vector<const char *>, {
+  std::vector<const char *> v;
+  if (!values) {
+    v.push_back(option->default_value().c_str());
+  } else {
+    for (auto &entry : *values) {
+      v.push_back(entry.c_str());
+    }
+  }
+  return v;
+})
+
+// Numeric defaults are returned as they were set, without any parsing.
+#define GET_VALUE_SPECIALIZE_NUMBER(type, converter)                           \
+  GET_VALUE_SPECIALIZE(type, {                                                 \
+    if (values) {                                                              \
+      return converter(values->front());                                       \
+    }                                                                          \
+    if (option->has_number_default()) {                                        \
+      return option->number_default<type>();                                   \
+    }                                                                          \
+    return converter(option->default_value());                                 \
+  })                                                                           \
   GET_VALUE_SPECIALIZE(std::vector<type>, {                                    \
     std::vector<type> v;                                                       \
-    for (auto &entry : m_values.at(key)) {                                     \
-      v.push_back(converter(entry));                                           \
+    if (!values) {                                                             \
+      v.push_back(option->has_number_default()                                 \
+                      ? option->number_default<type>()                         \
+                      : converter(option->default_value()));                   \
+    } else {                                                                   \
+      v.reserve(values->size());                                               \
+      for (auto &entry : *values) {                                            \
+        v.push_back(converter(entry));                                         \
+      }                                                                        \
     }                                                                          \
-    return std::move(v);                                                       \
+    return v;                                                                  \
   })
 
-GET_VALUE_SPECIALIZE_VECTOR(const char *,
-                            [](const std::string &s) { return s.c_str(); })
+GET_VALUE_SPECIALIZE_NUMBER(double, std::stod)
+
+GET_VALUE_SPECIALIZE_NUMBER(float, std::stof)
+
+GET_VALUE_SPECIALIZE_NUMBER(int, std::stoi)
+
+GET_VALUE_SPECIALIZE_NUMBER(unsigned int, std::stoul)
 
-GET_VALUE_SPECIALIZE_VECTOR(int, std::stoi)
+GET_VALUE_SPECIALIZE_NUMBER(long, std::stol)
 
-GET_VALUE_SPECIALIZE_VECTOR(unsigned int, std::stoul)
+GET_VALUE_SPECIALIZE_NUMBER(unsigned long, std::stoul)
 
-GET_VALUE_SPECIALIZE_VECTOR(float, std::stof)
+GET_VALUE_SPECIALIZE_NUMBER(long long, std::stoll)
 
-GET_VALUE_SPECIALIZE_VECTOR(double, std::stod)
+GET_VALUE_SPECIALIZE_NUMBER(unsigned long long, std::stoull)
 
 } // end namespace optionparser
 
@@ -0,0 +1,51 @@
+//-----------------------------------------------------------------------------
+//  optionparser.cppm -- C++20 module interface unit for optionparser.h
+//  Author: Luke de Oliveira <lukedeo@ldo.io>
+//  License: MIT
+//-----------------------------------------------------------------------------
+
+module;
+
+// Pull the standard headers into the global module fragment so the include
+// guards keep them out of the module purview below. Keep this list in sync
+// with the includes at the top of optionparser.h.
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+export module optionparser;
+
+// Export the whole optionparser namespace (OptionParser, Option, StorageMode,
+// ParserError, ...). The declarations stay attached to the global module so
+// that TUs which still #include the header see the very same entities.
+export extern "C++" {
+#include "optionparser.h"
+}
@@ -0,0 +1,13 @@
+// Option schema shared by test_docgen.cc and its build-time generator.
+
+optionparser::OptionParser optionparser_schema() {
+  optionparser::OptionParser p("Checks documentation generated at build time");
+  p.add_option("--number", "-n")
+      .help("A number to do something with")
+      .mode(optionparser::StorageMode::STORE_VALUE);
+  p.add_option("--file")
+      .help("pass a list of files to load.")
+      .mode(optionparser::StorageMode::STORE_MULT_VALUES);
+  p.add_option("input").help("positional input");
+  return p;
+}
@@ -0,0 +1,22 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <string>
+
+#include "doctest.h"
+#include "optionparser.h"
+
+#include "docgen_schema.h"
+#include "test_docgen_docs.h"
+
+TEST_CASE("test documentation generated at build time") {
+  auto p = optionparser_schema();
+  p.prog_name("docgen");
+
+  CHECK(std::string(test_docgen_docs::man_page) == p.man_page());
+  CHECK(std::string(test_docgen_docs::markdown) == p.markdown());
+
+  std::string help = test_docgen_docs::help_text;
+  CHECK(help.find("usage: docgen [-h]") == 0);
+  CHECK(help.find("[-n NUMBER]") != std::string::npos);
+  CHECK(help.find("pass a list of files to load.") != std::string::npos);
+}
@@ -1,6 +1,10 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 
+#include <atomic>
+#include <cstdint>
 #include <iterator>
+#include <sstream>
+#include <thread>
 
 #include "doctest.h"
 #include "optionparser.h"
@@ -393,3 +397,1731 @@ TEST_CASE("test OO functionality") {
   CHECK(qq[1] == "t2");
   CHECK(qq[2] == "t3");
 }
+
+#ifndef OPTIONPARSER_NO_HELP
+TEST_CASE("test help text is cached until the options change") {
+  auto p = parser();
+  p.add_option("--flag", "-f").help("just flag");
+
+  const std::string first = p.help_text();
+  CHECK(first.find("--flag, -f") != std::string::npos);
+  CHECK(first.find("just flag") != std::string::npos);
+  CHECK(&p.help_text() == &p.help_text());
+  CHECK(p.help_text() == first);
+
+  p.add_option("--other").help("another flag");
+  CHECK(p.help_text().find("another flag") != std::string::npos);
+
+  auto &late = p.add_option("--late");
+  CHECK(p.help_text().find("changed later") == std::string::npos);
+  late.help("changed later");
+  CHECK(p.help_text().find("changed later") != std::string::npos);
+}
+
+TEST_CASE("test text layout utilities") {
+  using namespace optionparser::utils;
+
+  SUBCASE("split keeps empty fields") {
+    auto v = split_str(" a  b", " ");
+    REQUIRE(v.size() == 4);
+    CHECK(v[0] == "");
+    CHECK(v[1] == "a");
+    CHECK(v[2] == "");
+    CHECK(v[3] == "b");
+    CHECK(split_str("a::b", "::").size() == 2);
+  }
+
+  SUBCASE("stitch wraps with a hanging indent") {
+    auto s = stitch_str({"aaaa", "bbbb", "cccc"}, 12, "  ");
+    CHECK(s == "  aaaa bbbb\n  cccc");
+  }
+
+  SUBCASE("display width counts columns, not bytes") {
+    CHECK(display_width("abc") == 3);
+    CHECK(display_width("h\xc3\xa9llo") == 5);
+    CHECK(display_width("\xe6\x97\xa5\xe6\x9c\xac") == 4);
+    CHECK(display_width("e\xcc\x81") == 1);
+  }
+
+  SUBCASE("wrapping uses display width") {
+    std::string out;
+    TextWrapper w(out, 5, "", 0);
+    w.words("\xc3\xa9\xc3\xa9 \xc3\xa9\xc3\xa9 x");
+    CHECK(out == "\xc3\xa9\xc3\xa9 \xc3\xa9\xc3\xa9\nx");
+  }
+}
+
+TEST_CASE("test man page and markdown rendering") {
+  auto p = parser();
+  p.prog_name("/usr/bin/tool");
+  p.add_option("--num-threads", "-j")
+      .help("worker count")
+      .mode(optionparser::StorageMode::STORE_VALUE);
+  p.add_option("input").help("file to read");
+
+  auto man = p.man_page();
+  CHECK(man.find(".TH \"TOOL\" 1\n") == 0);
+  CHECK(man.find(".SH SYNOPSIS\n.B tool\n") != std::string::npos);
+  CHECK(man.find("\\fB\\-\\-num\\-threads\\fR, \\fB\\-j\\fR "
+                 "\\fINUM\\-THREADS\\fR\nworker count\n") != std::string::npos);
+  CHECK(man.find(".SH ARGUMENTS\n.TP\n\\fBinput\\fR\nfile to read\n") !=
+        std::string::npos);
+
+  auto md = p.markdown();
+  CHECK(md.find("# tool\n") == 0);
+  CHECK(md.find("usage: tool [-h] [-j NUM-THREADS] [INPUT]\n") !=
+        std::string::npos);
+  CHECK(md.find("* `--num-threads`, `-j NUM-THREADS`: worker count\n") !=
+        std::string::npos);
+  CHECK(md.find("## Positional Arguments\n\n* `input`: file to read\n") !=
+        std::string::npos);
+}
+#endif // OPTIONPARSER_NO_HELP
+
+TEST_CASE("test command line tokenization") {
+  auto split = [](const std::string &command) {
+    std::string buffer = command;
+    std::vector<const char *> tokens;
+    REQUIRE(optionparser::utils::tokenize_command_line(buffer, tokens) ==
+            nullptr);
+    return std::vector<std::string>(tokens.begin(), tokens.end());
+  };
+  using V = std::vector<std::string>;
+
+  CHECK(split("") == V{});
+  CHECK(split("  run\t--threads   8 \n") == V{"run", "--threads", "8"});
+  CHECK(split("--name \"a b\" 'c d'") == V{"--name", "a b", "c d"});
+  CHECK(split("a\"b\"'c'd") == V{"abcd"});
+  CHECK(split("'' \"\"") == V{"", ""});
+  CHECK(split("'a\\b' \"a\\b\" a\\b") == V{"a\\b", "a\\b", "ab"});
+  CHECK(split("\"\\$x \\\"q\\\" \\\\\"") == V{"$x \"q\" \\"});
+  CHECK(split("a\\ b c") == V{"a b", "c"});
+  CHECK(split("a \\\n b\\\nc") == V{"a", "bc"});
+  CHECK(split("'it''s'") == V{"its"});
+
+  std::string buffer = "a 'b";
+  std::vector<const char *> tokens;
+  CHECK(optionparser::utils::tokenize_command_line(buffer, tokens) != nullptr);
+  buffer = "a \"b";
+  CHECK(optionparser::utils::tokenize_command_line(buffer, tokens) != nullptr);
+  buffer = "a\\";
+  CHECK(optionparser::utils::tokenize_command_line(buffer, tokens) != nullptr);
+}
+
+TEST_CASE("test parsing a command line string") {
+  auto p = parser();
+  p.add_option("--threads", "-t")
+      .mode(optionparser::StorageMode::STORE_VALUE);
+  p.add_option("--name").mode(optionparser::StorageMode::STORE_VALUE);
+  p.add_option("--verbose", "-v");
+
+  p.parse_command_line("run --threads 8 --name \"a b\" -v");
+  CHECK(p.get_value<int>("threads") == 8);
+  CHECK(p.get_value<std::string>("name") == "a b");
+  CHECK(p.get_value("verbose"));
+
+  auto q = parser();
+  CHECK_THROWS_AS(q.parse_command_line("run --name 'oops"),
+                  optionparser::ParserError);
+}
+
+TEST_CASE("test reusing a parser") {
+  auto p = parser();
+  p.add_option("--threads").mode(optionparser::StorageMode::STORE_VALUE);
+  p.add_option("--verbose", "-v");
+
+  p.parse_command_line("run --threads 8 -v");
+  CHECK(p.get_value<int>("threads") == 8);
+  CHECK(p.get_value("verbose"));
+
+  p.parse_command_line("run --threads 4");
+  CHECK(p.get_value<int>("threads") == 4);
+  CHECK(!p.get_value("verbose"));
+}
+
+TEST_CASE("test parsing ranges of arguments") {
+  auto check = [](optionparser::OptionParser &p) {
+    CHECK(p.get_value<int>("threads") == 8);
+    CHECK(p.get_value("verbose"));
+    CHECK(p.get_value<std::string>("input") == "file");
+  };
+
+  SUBCASE("vector of strings") {
+    std::vector<std::string> args = {"prog", "--threads", "8", "-v", "file"};
+    auto p = parser();
+    p.add_option("--threads").mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("--verbose", "-v");
+    p.add_option("input");
+    p.eat_arguments(args);
+    check(p);
+    CHECK(args.size() == 5);
+  }
+
+  SUBCASE("temporary vector of strings") {
+    // The values outlive the arguments they were parsed from.
+    auto p = parser();
+    p.add_option("--threads").mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("--verbose", "-v");
+    p.add_option("input");
+    p.eat_arguments(
+        std::vector<std::string>{"prog", "--threads", "8", "-v", "file"});
+    check(p);
+  }
+
+  SUBCASE("iterator range") {
+    const char *args[] = {"prog", "--threads", "8", "-v", "file"};
+    auto p = parser();
+    p.add_option("--threads").mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("--verbose", "-v");
+    p.add_option("input");
+    p.eat_arguments(std::begin(args), std::end(args));
+    check(p);
+  }
+
+  SUBCASE("array of pointers") {
+    const char *args[] = {"prog", "--threads", "8", "-v", "file"};
+    auto p = parser();
+    p.add_option("--threads").mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("--verbose", "-v");
+    p.add_option("input");
+    p.eat_arguments(args);
+    check(p);
+  }
+
+  SUBCASE("views that are not NUL-terminated") {
+    struct View {
+      const char *first;
+      std::size_t length;
+      const char *data() const { return first; }
+      std::size_t size() const { return length; }
+    };
+    const char *buffer = "prog--threads8-vfile";
+    std::vector<View> args = {{buffer, 4},
+                              {buffer + 4, 9},
+                              {buffer + 13, 1},
+                              {buffer + 14, 2},
+                              {buffer + 16, 4}};
+    auto p = parser();
+    p.add_option("--threads").mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("--verbose", "-v");
+    p.add_option("input");
+    p.eat_arguments(args);
+    check(p);
+    auto q = parser();
+    q.add_option("--threads").mode(optionparser::StorageMode::STORE_VALUE);
+    q.add_option("--verbose", "-v");
+    q.add_option("input");
+    auto rest = q.parse_known_args(args.begin(), args.end());
+    CHECK(rest.empty());
+    check(q);
+    std::vector<std::string> values;
+    auto r = parser();
+    r.add_option("--threads").mode(optionparser::StorageMode::STORE_VALUE);
+    r.add_option("--verbose", "-v");
+    r.add_option("input");
+    for (const auto &event : r.read_arguments(args.begin(), args.end())) {
+      values.push_back(event.value ? event.value : "");
+    }
+    CHECK(values == std::vector<std::string>{"8", "", "file"});
+  }
+
+  SUBCASE("empty range") {
+    auto p = parser();
+    p.add_option("--threads").mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("--verbose", "-v");
+    p.add_option("input");
+    p.eat_arguments(std::vector<std::string>());
+    CHECK(!p.get_value("verbose"));
+  }
+}
+
+TEST_CASE("test feeding arguments one at a time") {
+  auto p = parser();
+  p.add_option("--threads").mode(optionparser::StorageMode::STORE_VALUE);
+  p.add_option("--files").mode(optionparser::StorageMode::STORE_MULT_VALUES);
+  p.add_option("--verbose", "-v");
+  p.add_option("input");
+
+  p.begin_arguments("prog");
+  CHECK(p.feed("--threads") == 0);
+  CHECK(!p.get_value("threads"));
+  CHECK(p.feed(std::string("8")) == 1);
+  CHECK(p.get_value<int>("threads") == 8);
+
+  CHECK(p.feed("--files") == 0);
+  CHECK(p.feed("a") == 0);
+  CHECK(p.feed("b") == 0);
+  CHECK(!p.get_value("files"));
+  CHECK(p.feed("-v") == 2);
+  CHECK(p.get_value<std::vector<std::string>>("files") ==
+        std::vector<std::string>{"a", "b"});
+  CHECK(p.get_value("verbose"));
+
+  CHECK(p.feed("in") == 1);
+  CHECK(p.get_value<std::string>("input") == "in");
+  p.end_arguments();
+
+  p.begin_arguments("prog");
+  CHECK(p.feed("--files") == 0);
+  CHECK(p.feed("c") == 0);
+  CHECK(!p.get_value("files"));
+  p.end_arguments();
+  CHECK(p.get_value<std::vector<std::string>>("files") ==
+        std::vector<std::string>{"c"});
+  CHECK(!p.get_value("input"));
+}
+
+TEST_CASE("test values attached with an equals sign") {
+  const char *argv[] = {"tests", "--threads=8", "--name=a=b", "--empty="};
+  auto p = parser();
+  p.add_option("--threads").mode(optionparser::StorageMode::STORE_VALUE);
+  p.add_option("--name").mode(optionparser::StorageMode::STORE_VALUE);
+  p.add_option("--empty").mode(optionparser::StorageMode::STORE_VALUE);
+  p.eat_arguments(length(argv), argv);
+  CHECK(p.get_value<int>("threads") == 8);
+  CHECK(p.get_value<std::string>("name") == "a=b");
+  CHECK(p.get_value<std::string>("empty") == "");
+}
+
+TEST_CASE("test missing value for a flag") {
+  const char *argv[] = {"tests", "--threads"};
+  auto p = parser();
+  p.add_option("--threads").mode(optionparser::StorageMode::STORE_VALUE);
+  CHECK_THROWS_AS(p.eat_arguments(length(argv), argv),
+                  optionparser::ParserError);
+
+  auto q = parser();
+  q.add_option("--threads")
+      .mode(optionparser::StorageMode::STORE_VALUE)
+      .default_value(4);
+  q.eat_arguments(length(argv), argv);
+  CHECK(q.get_value<int>("threads") == 4);
+}
+
+TEST_CASE("test reading arguments as events") {
+  const char *argv[] = {"tests",     "--files",  "a",  "b",
+                        "-v",        "--threads", "--name=x", "in"};
+  SUBCASE("all events in argument order") {
+    auto p = parser();
+    p.add_option("--threads")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .default_value(4);
+    p.add_option("--files").mode(optionparser::StorageMode::STORE_MULT_VALUES);
+    p.add_option("--name").mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("--verbose", "-v");
+    p.add_option("input");
+    std::vector<std::string> seen;
+    for (const auto &event : p.read_arguments(length(argv), argv)) {
+      seen.push_back(event.option->dest() + "=" +
+                     (event.value ? event.value : "<flag>"));
+    }
+    CHECK(seen == std::vector<std::string>{"files=a", "files=b",
+                                           "verbose=<flag>", "threads=4",
+                                           "name=x", "input=in"});
+    CHECK(p.get_value("files"));
+    CHECK(p.get_value("name"));
+  }
+
+  SUBCASE("values point into argv") {
+    auto p = parser();
+    p.add_option("--threads")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .default_value(4);
+    p.add_option("--files").mode(optionparser::StorageMode::STORE_MULT_VALUES);
+    p.add_option("--name").mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("--verbose", "-v");
+    p.add_option("input");
+    auto reader = p.read_arguments(length(argv), argv);
+    optionparser::ParseEvent event;
+    REQUIRE(reader.next(event));
+    CHECK(event.value == argv[2]);
+  }
+
+  SUBCASE("stopping early") {
+    auto p = parser();
+    p.add_option("--threads")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .default_value(4);
+    p.add_option("--files").mode(optionparser::StorageMode::STORE_MULT_VALUES);
+    p.add_option("--name").mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("--verbose", "-v");
+    p.add_option("input");
+    auto reader = p.read_arguments(length(argv), argv);
+    optionparser::ParseEvent event;
+    REQUIRE(reader.next(event));
+    REQUIRE(reader.next(event));
+    CHECK(std::string(event.value) == "b");
+    CHECK(!p.get_value("verbose"));
+  }
+
+  SUBCASE("ranges of strings") {
+    std::vector<std::string> args(argv, argv + length(argv));
+    auto p = parser();
+    p.add_option("--threads")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .default_value(4);
+    p.add_option("--files").mode(optionparser::StorageMode::STORE_MULT_VALUES);
+    p.add_option("--name").mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("--verbose", "-v");
+    p.add_option("input");
+    std::size_t count = 0;
+    for (const auto &event : p.read_arguments(args.begin(), args.end())) {
+      (void)event;
+      ++count;
+    }
+    CHECK(count == 6);
+  }
+}
+
+TEST_CASE("test parsing known arguments") {
+  SUBCASE("unknown arguments are handed back in order") {
+    const char *argv[] = {"tests", "--color", "--threads", "8",
+                          "child",  "-v",      "-x"};
+    auto p = parser();
+    p.add_option("--threads").mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("--verbose", "-v");
+    auto rest = p.parse_known_args(length(argv), argv);
+    CHECK(p.get_value<int>("threads") == 8);
+    CHECK(p.get_value("verbose"));
+    REQUIRE(rest.size() == 3);
+    CHECK(rest[0] == argv[1]);
+    CHECK(rest[1] == argv[4]);
+    CHECK(rest[2] == argv[6]);
+  }
+
+  SUBCASE("everything after -- is handed back") {
+    const char *argv[] = {"tests", "-v", "--", "--threads", "8", "--"};
+    auto p = parser();
+    p.add_option("--threads").mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("--verbose", "-v");
+    auto rest = p.parse_known_args(length(argv), argv);
+    CHECK(p.get_value("verbose"));
+    CHECK(!p.get_value("threads"));
+    REQUIRE(rest.size() == 3);
+    CHECK(rest[0] == argv[3]);
+    CHECK(rest[2] == argv[5]);
+  }
+
+  SUBCASE("ranges hand back iterators") {
+    std::vector<std::string> args = {"tests", "--threads", "8", "--color"};
+    auto p = parser();
+    p.add_option("--threads").mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("--verbose", "-v");
+    auto rest = p.parse_known_args(args.begin(), args.end());
+    REQUIRE(rest.size() == 1);
+    CHECK(rest[0] == args.begin() + 3);
+  }
+
+  SUBCASE("prefixes of our flags are not abbreviations") {
+    auto p = parser();
+    p.add_option("--verbose", "-v");
+    p.add_option("--version");
+    const char *argv[] = {"tests", "--v", "--ver", "--verb", "child"};
+    auto rest = p.parse_known_args(length(argv), argv);
+    CHECK(!p.get_value("verbose"));
+    REQUIRE(rest.size() == 4);
+    CHECK(rest[0] == argv[1]);
+    CHECK(rest[1] == argv[2]);
+    CHECK(rest[2] == argv[3]);
+  }
+
+  SUBCASE("-- ends options for eat_arguments too") {
+    const char *argv[] = {"tests", "--", "-v"};
+    auto p = parser();
+    p.add_option("--threads").mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("--verbose", "-v");
+    p.add_option("input");
+    p.eat_arguments(length(argv), argv);
+    CHECK(!p.get_value("verbose"));
+    CHECK(p.get_value<std::string>("input") == "-v");
+  }
+}
+
+TEST_CASE("test subcommands") {
+  int built = 0;
+  SUBCASE("only the selected subcommand is built") {
+    const char *argv[] = {"tests", "-v", "build", "-j", "4", "app"};
+    auto p = parser();
+    p.add_option("--verbose", "-v");
+    p.add_subcommand(
+        "build",
+        [&built](optionparser::OptionParser &sub) {
+          ++built;
+          sub.add_option("--jobs", "-j")
+              .mode(optionparser::StorageMode::STORE_VALUE)
+              .default_value(1);
+          sub.add_option("target");
+        },
+        "Build a target");
+    p.add_subcommand("clean", [&built](optionparser::OptionParser &sub) {
+      ++built;
+      sub.add_option("--all");
+    });
+    p.eat_arguments(length(argv), argv);
+    CHECK(built == 1);
+    CHECK(p.get_value("verbose"));
+    CHECK(p.subcommand() == "build");
+    auto &sub = p.subparser();
+    CHECK(sub.get_value<int>("jobs") == 4);
+    CHECK(sub.get_value<std::string>("target") == "app");
+  }
+
+  SUBCASE("options after the subcommand belong to it") {
+    const char *argv[] = {"tests", "clean", "--all", "-v"};
+    auto p = parser();
+    p.add_option("--verbose", "-v");
+    p.add_subcommand(
+        "build",
+        [&built](optionparser::OptionParser &sub) {
+          ++built;
+          sub.add_option("--jobs", "-j")
+              .mode(optionparser::StorageMode::STORE_VALUE)
+              .default_value(1);
+          sub.add_option("target");
+        },
+        "Build a target");
+    p.add_subcommand("clean", [&built](optionparser::OptionParser &sub) {
+      ++built;
+      sub.add_option("--all");
+    });
+    auto rest = p.parse_known_args(length(argv), argv);
+    CHECK(built == 1);
+    CHECK(p.subparser().get_value("all"));
+    CHECK(!p.get_value("verbose"));
+    REQUIRE(rest.size() == 1);
+    CHECK(rest[0] == argv[3]);
+  }
+
+  SUBCASE("no subcommand selected") {
+    const char *argv[] = {"tests", "-v"};
+    auto p = parser();
+    p.add_option("--verbose", "-v");
+    p.add_subcommand(
+        "build",
+        [&built](optionparser::OptionParser &sub) {
+          ++built;
+          sub.add_option("--jobs", "-j")
+              .mode(optionparser::StorageMode::STORE_VALUE)
+              .default_value(1);
+          sub.add_option("target");
+        },
+        "Build a target");
+    p.add_subcommand("clean", [&built](optionparser::OptionParser &sub) {
+      ++built;
+      sub.add_option("--all");
+    });
+    p.eat_arguments(length(argv), argv);
+    CHECK(built == 0);
+    CHECK(p.subcommand().empty());
+    CHECK_THROWS_AS(p.subparser(), optionparser::ParserError);
+  }
+
+  SUBCASE("duplicate subcommands are rejected") {
+    auto p = parser();
+    p.add_option("--verbose", "-v");
+    p.add_subcommand(
+        "build",
+        [&built](optionparser::OptionParser &sub) {
+          ++built;
+          sub.add_option("--jobs", "-j")
+              .mode(optionparser::StorageMode::STORE_VALUE)
+              .default_value(1);
+          sub.add_option("target");
+        },
+        "Build a target");
+    p.add_subcommand("clean", [&built](optionparser::OptionParser &sub) {
+      ++built;
+      sub.add_option("--all");
+    });
+    CHECK_THROWS_AS(
+        p.add_subcommand("build", [](optionparser::OptionParser &) {}),
+        optionparser::ParserError);
+  }
+
+#ifndef OPTIONPARSER_NO_HELP
+  SUBCASE("subcommands are listed in the help text") {
+    auto p = parser();
+    p.add_option("--verbose", "-v");
+    p.add_subcommand(
+        "build",
+        [&built](optionparser::OptionParser &sub) {
+          ++built;
+          sub.add_option("--jobs", "-j")
+              .mode(optionparser::StorageMode::STORE_VALUE)
+              .default_value(1);
+          sub.add_option("target");
+        },
+        "Build a target");
+    p.add_subcommand("clean", [&built](optionparser::OptionParser &sub) {
+      ++built;
+      sub.add_option("--all");
+    });
+    const auto &text = p.help_text();
+    CHECK(text.find("COMMAND ...") != std::string::npos);
+    CHECK(text.find("\nCommands:\n    build                Build a target\n") !=
+          std::string::npos);
+    CHECK(built == 0);
+  }
+#endif
+}
+
+TEST_CASE("test clustered short flags") {
+  SUBCASE("flags and a trailing value option") {
+    const char *argv[] = {"tests", "-xzf", "archive.tar"};
+    auto p = parser();
+    p.add_option("-v");
+    p.add_option("-x");
+    p.add_option("-z");
+    p.add_option("-f").mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("--threads", "-n")
+        .mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("input");
+    p.eat_arguments(length(argv), argv);
+    CHECK(p.get_value("x_option"));
+    CHECK(p.get_value("z_option"));
+    CHECK(p.get_value<std::string>("f_option") == "archive.tar");
+    CHECK(!p.get_value("input"));
+  }
+
+  SUBCASE("attached values") {
+    const char *argv[] = {"tests", "-n5", "-vfname.txt"};
+    auto p = parser();
+    p.add_option("-v");
+    p.add_option("-x");
+    p.add_option("-z");
+    p.add_option("-f").mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("--threads", "-n")
+        .mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("input");
+    p.eat_arguments(length(argv), argv);
+    CHECK(p.get_value<int>("threads") == 5);
+    CHECK(p.get_value("v_option"));
+    CHECK(p.get_value<std::string>("f_option") == "name.txt");
+  }
+
+  SUBCASE("repeated flags are reported once per occurrence") {
+    const char *argv[] = {"tests", "-vvv"};
+    auto p = parser();
+    p.add_option("-v");
+    p.add_option("-x");
+    p.add_option("-z");
+    p.add_option("-f").mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("--threads", "-n")
+        .mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("input");
+    std::size_t count = 0;
+    for (const auto &event : p.read_arguments(length(argv), argv)) {
+      CHECK(event.option->dest() == "v_option");
+      ++count;
+    }
+    CHECK(count == 3);
+  }
+
+  SUBCASE("arguments that are not clusters stay positional") {
+    const char *argv[] = {"tests", "-vq"};
+    auto p = parser();
+    p.add_option("-v");
+    p.add_option("-x");
+    p.add_option("-z");
+    p.add_option("-f").mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("--threads", "-n")
+        .mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("input");
+    p.eat_arguments(length(argv), argv);
+    CHECK(!p.get_value("v_option"));
+    CHECK(p.get_value<std::string>("input") == "-vq");
+  }
+}
+
+TEST_CASE("test abbreviated long flags") {
+  SUBCASE("unambiguous prefixes match") {
+    const char *argv[] = {"tests", "--verb", "--th", "4"};
+    auto p = parser();
+    p.add_option("--verbose");
+    p.add_option("--version");
+    p.add_option("--threads").mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("input");
+    p.eat_arguments(length(argv), argv);
+    CHECK(p.get_value("verbose"));
+    CHECK(!p.get_value("version"));
+    CHECK(p.get_value<int>("threads") == 4);
+  }
+
+  SUBCASE("prefixes with attached values") {
+    const char *argv[] = {"tests", "--thr=8"};
+    auto p = parser();
+    p.add_option("--verbose");
+    p.add_option("--version");
+    p.add_option("--threads").mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("input");
+    p.eat_arguments(length(argv), argv);
+    CHECK(p.get_value<int>("threads") == 8);
+  }
+
+  SUBCASE("ambiguous prefixes list every candidate") {
+    const char *argv[] = {"tests", "--ver"};
+    auto p = parser();
+    p.add_option("--verbose");
+    p.add_option("--version");
+    p.add_option("--threads").mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("input");
+    try {
+      p.eat_arguments(length(argv), argv);
+      FAIL("expected an ambiguity error");
+    } catch (const optionparser::ParserError &err) {
+      CHECK(std::string(err.what()) ==
+            "Ambiguous option '--ver' could match --verbose, --version");
+    }
+  }
+
+  SUBCASE("prefixes of deprecated aliases resolve to the option") {
+    const char *argv[] = {"tests", "--num-t", "4"};
+    auto p = parser();
+    p.add_option("--num-threads")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .deprecated_alias("--num-thread");
+    std::ostringstream err;
+    auto *old = std::cerr.rdbuf(err.rdbuf());
+    p.eat_arguments(length(argv), argv);
+    std::cerr.rdbuf(old);
+    CHECK(p.get_value<int>("num-threads") == 4);
+    CHECK(err.str().empty());
+  }
+
+  SUBCASE("abbreviations can be turned off") {
+    const char *argv[] = {"tests", "--verb"};
+    auto p = parser();
+    p.add_option("--verbose");
+    p.add_option("--version");
+    p.add_option("--threads").mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("input");
+    p.allow_abbrev(false);
+    p.eat_arguments(length(argv), argv);
+    CHECK(!p.get_value("verbose"));
+    CHECK(p.get_value<std::string>("input") == "--verb");
+  }
+}
+
+TEST_CASE("test edit distance") {
+  using optionparser::utils::EditDistance;
+  CHECK(EditDistance("kitten")("sitting") == 3);
+  CHECK(EditDistance("flaw")("lawn") == 2);
+  CHECK(EditDistance("")("abc") == 3);
+  CHECK(EditDistance("abc")("") == 3);
+  CHECK(EditDistance("--verbose")("--verbose") == 0);
+  CHECK(EditDistance("--vrebose")("--verbose") == 2);
+
+  // Patterns longer than a machine word take the plain DP path, which must
+  // agree with the bit-parallel one.
+  std::string long_text(70, 'a');
+  long_text[10] = 'b';
+  long_text[50] = 'c';
+  for (const char *text :
+       {"aaaa", "abca", "", "bcbcbcbc", "aaaaaaaaaaaaaaaa"}) {
+    CHECK(EditDistance(long_text)(text) == EditDistance(text)(long_text));
+  }
+}
+
+TEST_CASE("test suggestions for unrecognized arguments") {
+  auto p = parser();
+  p.add_option("--verbose", "-v");
+  p.add_option("--version");
+  p.add_option("--color");
+  p.add_subcommand("build", [](optionparser::OptionParser &) {});
+
+  CHECK(p.suggest("--colr") == std::vector<std::string>{"--color"});
+  CHECK(p.suggest("--verbos") ==
+        std::vector<std::string>{"--verbose", "--version"});
+  CHECK(p.suggest("biuld") == std::vector<std::string>{"build"});
+  CHECK(p.suggest("-q").empty());
+  CHECK(p.suggest("--zzzzzz").empty());
+
+  const char *argv[] = {"tests", "--colour"};
+  try {
+    p.eat_arguments(length(argv), argv);
+    FAIL("expected an unrecognized argument");
+  } catch (const optionparser::ParserError &err) {
+    CHECK(std::string(err.what()) ==
+          "Unrecognized flag/option '--colour', did you mean '--color'?");
+  }
+
+  // Registered flags are never suggested for themselves.
+  CHECK(p.suggest("--color").empty());
+  CHECK(p.suggest("-v").empty());
+}
+
+TEST_CASE("test registered flags that cannot be taken") {
+  SUBCASE("an option taking a value given twice") {
+    auto p = parser();
+    p.add_option("--threads", "-t")
+        .mode(optionparser::StorageMode::STORE_VALUE);
+    for (const char *flag : {"--threads", "-t"}) {
+      const char *argv[] = {"tests", "--threads", "4", flag, "8"};
+      try {
+        p.eat_arguments(length(argv), argv);
+        FAIL("expected a repeated flag");
+      } catch (const optionparser::ParserError &err) {
+        CHECK(std::string(err.what()) ==
+              "error, flag '" + std::string(flag) +
+                  "' was given more than once.");
+      }
+    }
+  }
+
+  SUBCASE("a flag after --") {
+    auto p = parser();
+    p.add_option("--verbose", "-v");
+    const char *argv[] = {"tests", "--", "-v"};
+    try {
+      p.eat_arguments(length(argv), argv);
+      FAIL("expected a flag after --");
+    } catch (const optionparser::ParserError &err) {
+      CHECK(std::string(err.what()) ==
+            "error, flag '-v' comes after '--', where flags are not "
+            "recognized.");
+    }
+  }
+}
+
+TEST_CASE("test flag aliases") {
+  SUBCASE("every alias sets the same option") {
+    for (const char *flag : {"--num-threads", "--threads", "-j"}) {
+      const char *argv[] = {"tests", flag, "4"};
+      auto p = parser();
+      p.add_option("--num-threads")
+          .mode(optionparser::StorageMode::STORE_VALUE)
+          .alias("--threads")
+          .alias("-j")
+          .deprecated_alias("--nthreads");
+      p.add_option("--verbose").alias("-v");
+      p.eat_arguments(length(argv), argv);
+      CHECK(p.get_value<int>("num-threads") == 4);
+    }
+  }
+
+  SUBCASE("short aliases cluster") {
+    const char *argv[] = {"tests", "-vj8"};
+    auto p = parser();
+    p.add_option("--num-threads")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .alias("--threads")
+        .alias("-j")
+        .deprecated_alias("--nthreads");
+    p.add_option("--verbose").alias("-v");
+    p.eat_arguments(length(argv), argv);
+    CHECK(p.get_value("verbose"));
+    CHECK(p.get_value<int>("num-threads") == 8);
+  }
+
+  SUBCASE("deprecated aliases warn once") {
+    const char *argv[] = {"tests", "--nthreads", "2"};
+    auto p = parser();
+    p.add_option("--num-threads")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .alias("--threads")
+        .alias("-j")
+        .deprecated_alias("--nthreads");
+    p.add_option("--verbose").alias("-v");
+    std::ostringstream err;
+    auto *old = std::cerr.rdbuf(err.rdbuf());
+    p.eat_arguments(length(argv), argv);
+    p.eat_arguments(length(argv), argv);
+    std::cerr.rdbuf(old);
+    CHECK(p.get_value<int>("num-threads") == 2);
+    CHECK(err.str() == "Warning: flag '--nthreads' is deprecated, use "
+                       "'--num-threads' instead.\n");
+  }
+
+  SUBCASE("invalid aliases are rejected") {
+    auto p = parser();
+    CHECK_THROWS_AS(p.add_option("--verbose").alias("verbose"),
+                    std::runtime_error);
+  }
+
+#ifndef OPTIONPARSER_NO_HELP
+  SUBCASE("deprecated aliases are not documented") {
+    auto p = parser();
+    p.add_option("--num-threads")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .alias("--threads")
+        .alias("-j")
+        .deprecated_alias("--nthreads");
+    p.add_option("--verbose").alias("-v");
+    CHECK(p.help_text().find("--num-threads, --threads, -j") !=
+          std::string::npos);
+    CHECK(p.help_text().find("--nthreads") == std::string::npos);
+  }
+#endif
+}
+
+TEST_CASE("test delimited list values") {
+  SUBCASE("elements of every value are decoded in order") {
+    const char *argv[] = {"tests", "--ids", "1,2,3", "40", "5,-6"};
+    auto p = parser();
+    p.add_option("--ids")
+        .mode(optionparser::StorageMode::STORE_MULT_VALUES)
+        .separator(',');
+    p.add_option("--weights")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .separator(':')
+        .default_value("0.5:1.5");
+    p.eat_arguments(length(argv), argv);
+    CHECK(p.get_list<int>("ids") == std::vector<int>{1, 2, 3, 40, 5, -6});
+    CHECK(p.get_list<std::string>("ids") ==
+          std::vector<std::string>{"1", "2", "3", "40", "5", "-6"});
+    CHECK(p.get_list<double>("weights") == std::vector<double>{0.5, 1.5});
+  }
+
+  SUBCASE("decoding into a caller buffer") {
+    const char *argv[] = {"tests", "--ids=7,8,9"};
+    auto p = parser();
+    p.add_option("--ids")
+        .mode(optionparser::StorageMode::STORE_MULT_VALUES)
+        .separator(',');
+    p.add_option("--weights")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .separator(':')
+        .default_value("0.5:1.5");
+    p.eat_arguments(length(argv), argv);
+    long long ids[2] = {};
+    CHECK(p.get_list("ids", ids, 2) == 3);
+    CHECK(ids[0] == 7);
+    CHECK(ids[1] == 8);
+  }
+
+  SUBCASE("invalid elements are reported") {
+    auto p = parser();
+    p.add_option("--ids")
+        .mode(optionparser::StorageMode::STORE_MULT_VALUES)
+        .separator(',');
+    p.add_option("--weights")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .separator(':')
+        .default_value("0.5:1.5");
+    for (const char *ids : {"1,,2", "1,x", "1,2,", "300"}) {
+      const char *argv[] = {"tests", "--ids", ids};
+      p.eat_arguments(length(argv), argv);
+      CHECK_THROWS_AS(p.get_list<unsigned char>("ids"),
+                      optionparser::ParserError);
+    }
+    const char *argv[] = {"tests", "--ids=-1"};
+    p.eat_arguments(length(argv), argv);
+    CHECK_THROWS_AS(p.get_list<unsigned int>("ids"),
+                    optionparser::ParserError);
+  }
+
+  SUBCASE("numbers are written plainly") {
+    auto p = parser();
+    p.add_option("--ids")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .separator(',');
+    for (const char *ids : {"1, -5", "1,+3", "1, 2", "-0"}) {
+      auto arg = std::string("--ids=") + ids;
+      const char *argv[] = {"tests", arg.c_str()};
+      p.eat_arguments(length(argv), argv);
+      CHECK_THROWS_AS(p.get_list<unsigned long long>("ids"),
+                      optionparser::ParserError);
+    }
+    for (const char *ids : {"1, -5", "1,+3", "1,-+3"}) {
+      auto arg = std::string("--ids=") + ids;
+      const char *argv[] = {"tests", arg.c_str()};
+      p.eat_arguments(length(argv), argv);
+      CHECK_THROWS_AS(p.get_list<long>("ids"), optionparser::ParserError);
+      CHECK_THROWS_AS(p.get_list<double>("ids"), optionparser::ParserError);
+    }
+    const char *argv[] = {"tests", "--ids=-5,.5,-0.25"};
+    p.eat_arguments(length(argv), argv);
+    CHECK(p.get_list<double>("ids") == std::vector<double>{-5, .5, -0.25});
+  }
+
+  SUBCASE("options without a separator have one element per value") {
+    const char *argv[] = {"tests", "--ids", "1,2"};
+    auto p = parser();
+    p.add_option("--ids").mode(optionparser::StorageMode::STORE_MULT_VALUES);
+    p.eat_arguments(length(argv), argv);
+    CHECK(p.get_list<std::string>("ids") == std::vector<std::string>{"1,2"});
+  }
+}
+
+TEST_CASE("test map options") {
+  SUBCASE("repeated key=value arguments, last one wins") {
+    const char *argv[] = {"tests",          "--set", "a=1", "-sb=2",
+                          "--set=a=3",      "--set", "c=",  "--set",
+                          "url=http://x?y=z"};
+    auto p = parser();
+    p.add_option("--set", "-s").mode(optionparser::StorageMode::STORE_MAP);
+    p.add_option("--env")
+        .mode(optionparser::StorageMode::STORE_MAP)
+        .default_value("HOME=/root");
+    p.eat_arguments(length(argv), argv);
+    CHECK(std::string(p.get_map_value("set", "a")) == "3");
+    CHECK(std::string(p.get_map_value("set", "b")) == "2");
+    CHECK(std::string(p.get_map_value("set", "c")).empty());
+    CHECK(std::string(p.get_map_value("set", "url")) == "http://x?y=z");
+    CHECK(p.get_map_value("set", "d") == nullptr);
+    CHECK(std::string(p.get_map_value("env", "HOME")) == "/root");
+    CHECK(p.get_value<std::vector<std::string>>("set").size() == 5);
+  }
+
+  SUBCASE("not given") {
+    auto p = parser();
+    p.add_option("--set", "-s").mode(optionparser::StorageMode::STORE_MAP);
+    p.add_option("--env")
+        .mode(optionparser::StorageMode::STORE_MAP)
+        .default_value("HOME=/root");
+    const char *argv[] = {"tests"};
+    p.eat_arguments(length(argv), argv);
+    CHECK(p.get_map_value("set", "a") == nullptr);
+    CHECK(p.get_map_value("env", "PATH") == nullptr);
+    CHECK(std::string(p.get_map_value("env", "HOME")) == "/root");
+    CHECK_THROWS_AS(p.get_map_value("unset", "a"), optionparser::ParserError);
+  }
+
+  SUBCASE("many keys") {
+    std::vector<std::string> args = {"tests"};
+    for (int i = 0; i < 1000; ++i) {
+      args.push_back("--set");
+      args.push_back("key" + std::to_string(i % 500) + "=" +
+                     std::to_string(i));
+    }
+    auto p = parser();
+    p.add_option("--set", "-s").mode(optionparser::StorageMode::STORE_MAP);
+    p.add_option("--env")
+        .mode(optionparser::StorageMode::STORE_MAP)
+        .default_value("HOME=/root");
+    p.eat_arguments(args.begin(), args.end());
+    for (int i = 0; i < 500; ++i) {
+      auto value = p.get_map_value("set", "key" + std::to_string(i));
+      REQUIRE(value != nullptr);
+      CHECK(std::string(value) == std::to_string(i + 500));
+    }
+  }
+
+  SUBCASE("entries need a key") {
+    const char *argv[] = {"tests", "--set", "a"};
+    auto p = parser();
+    p.add_option("--set", "-s").mode(optionparser::StorageMode::STORE_MAP);
+    p.add_option("--env")
+        .mode(optionparser::StorageMode::STORE_MAP)
+        .default_value("HOME=/root");
+    CHECK_THROWS_AS(p.eat_arguments(length(argv), argv),
+                    optionparser::ParserError);
+    CHECK_THROWS_AS(p.get_map_value("nope", "a"), optionparser::ParserError);
+  }
+}
+
+TEST_CASE("test typed default values") {
+  const char *argv[] = {"tests"};
+  auto p = parser();
+  p.add_option("--ratio")
+      .mode(optionparser::StorageMode::STORE_VALUE)
+      .default_value(0.1);
+  p.add_option("--third")
+      .mode(optionparser::StorageMode::STORE_VALUE)
+      .default_value(1.0 / 3);
+  p.add_option("--big")
+      .mode(optionparser::StorageMode::STORE_VALUE)
+      .default_value(std::int64_t(9007199254740993));
+  p.add_option("--huge")
+      .mode(optionparser::StorageMode::STORE_VALUE)
+      .default_value(std::numeric_limits<unsigned long long>::max());
+  p.add_option("--count")
+      .mode(optionparser::StorageMode::STORE_MULT_VALUES)
+      .default_value(3);
+  p.eat_arguments(length(argv), argv);
+
+  SUBCASE("numbers read back exactly") {
+    CHECK(p.get_value<double>("ratio") == 0.1);
+    CHECK(p.get_value<double>("third") == 1.0 / 3);
+    CHECK(p.get_value<std::int64_t>("big") == 9007199254740993);
+    CHECK(p.get_value<long long>("big") == 9007199254740993);
+    CHECK(p.get_value<unsigned long long>("huge") ==
+          std::numeric_limits<unsigned long long>::max());
+    CHECK(p.get_value<std::vector<int>>("count") == std::vector<int>{3});
+  }
+
+  SUBCASE("their text round-trips too") {
+    CHECK(p.get_value<std::string>("ratio") == "0.1");
+    CHECK(std::stod(p.get_value<std::string>("third")) == 1.0 / 3);
+    CHECK(p.get_value<std::string>("big") == "9007199254740993");
+    CHECK(p.get_value<std::vector<std::string>>("count") ==
+          std::vector<std::string>{"3"});
+  }
+
+  SUBCASE("given values take precedence") {
+    const char *given[] = {"tests", "--ratio", "2.5", "--count", "1", "2"};
+    p.eat_arguments(length(given), given);
+    CHECK(p.get_value<double>("ratio") == 2.5);
+    CHECK(p.get_value<std::vector<int>>("count") == std::vector<int>{1, 2});
+    CHECK(p.get_value<double>("third") == 1.0 / 3);
+  }
+
+  SUBCASE("numbers out of range fail as their text does") {
+    p.add_option("--far")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .default_value(1e300);
+    p.add_option("--fartext")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .default_value("1e300");
+    p.add_option("--negative")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .default_value(-1);
+    p.eat_arguments(length(argv), argv);
+    CHECK_THROWS_AS(p.get_value<float>("far"), optionparser::ParserError);
+    CHECK_THROWS_AS(p.get_value<float>("fartext"), optionparser::ParserError);
+    CHECK_THROWS_AS(p.get_value<std::vector<float>>("far"),
+                    optionparser::ParserError);
+    CHECK_THROWS_AS(p.get_value<int>("huge"), optionparser::ParserError);
+    CHECK_THROWS_AS(p.get_value<long long>("huge"), optionparser::ParserError);
+    CHECK_THROWS_AS(p.get_value<unsigned int>("negative"),
+                    optionparser::ParserError);
+    CHECK_THROWS_AS(p.get_value<long>("far"), optionparser::ParserError);
+    CHECK(p.get_value<double>("far") == 1e300);
+    CHECK(p.get_value<double>("fartext") == 1e300);
+    CHECK(p.get_value<int>("negative") == -1);
+    CHECK(p.get_value<float>("big") == 9007199254740993.0f);
+  }
+}
+
+TEST_CASE("test lazily computed default values") {
+  std::atomic<int> calls(0);
+  SUBCASE("not evaluated when the option is given or never read") {
+    const char *argv[] = {"tests", "--jobs", "2"};
+    auto p = parser();
+    p.add_option("--jobs")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .default_from([&calls]() {
+          ++calls;
+          return 8;
+        });
+    p.add_option("--socket")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .default_from([]() { return std::string("/run/app.sock"); });
+    p.eat_arguments(length(argv), argv);
+    CHECK(p.get_value<int>("jobs") == 2);
+    const char *none[] = {"tests"};
+    p.eat_arguments(length(none), none);
+    CHECK(p.get_value("jobs"));
+    CHECK(calls == 0);
+  }
+
+  SUBCASE("evaluated once on first read") {
+    const char *argv[] = {"tests"};
+    auto p = parser();
+    p.add_option("--jobs")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .default_from([&calls]() {
+          ++calls;
+          return 8;
+        });
+    p.add_option("--socket")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .default_from([]() { return std::string("/run/app.sock"); });
+    p.eat_arguments(length(argv), argv);
+    CHECK(p.get_value<int>("jobs") == 8);
+    CHECK(p.get_value<std::string>("jobs") == "8");
+    CHECK(p.get_value<std::string>("socket") == "/run/app.sock");
+    CHECK(calls == 1);
+  }
+
+  SUBCASE("concurrent reads evaluate once") {
+    const char *argv[] = {"tests"};
+    auto p = parser();
+    p.add_option("--jobs")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .default_from([&calls]() {
+          ++calls;
+          return 8;
+        });
+    p.add_option("--socket")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .default_from([]() { return std::string("/run/app.sock"); });
+    p.eat_arguments(length(argv), argv);
+    std::vector<std::thread> threads;
+    std::atomic<int> wrong(0);
+    for (int i = 0; i < 8; ++i) {
+      threads.emplace_back([&p, &wrong]() {
+        if (p.get_value<int>("jobs") != 8) {
+          ++wrong;
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    CHECK(wrong == 0);
+    CHECK(calls == 1);
+  }
+}
+
+TEST_CASE("test option constraints") {
+  SUBCASE("satisfied constraints") {
+    const char *argv[] = {"tests", "--json", "-q", "--user", "me",
+                          "--password", "pw"};
+    auto p = parser();
+    p.add_option("--json");
+    p.add_option("--yaml");
+    p.add_option("--quiet", "-q");
+    p.add_option("--verbose", "-v");
+    p.add_option("--user").mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("--password")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .default_value("secret");
+    p.exactly_one_of({"json", "yaml"})
+        .at_most_one_of({"quiet", "verbose"})
+        .requires_options("user", {"password"});
+    CHECK_NOTHROW(p.eat_arguments(length(argv), argv));
+  }
+
+  SUBCASE("every violation is reported, defaults do not count") {
+    const char *argv[] = {"tests", "-q", "-v", "--user", "me"};
+    auto p = parser();
+    p.add_option("--json");
+    p.add_option("--yaml");
+    p.add_option("--quiet", "-q");
+    p.add_option("--verbose", "-v");
+    p.add_option("--user").mode(optionparser::StorageMode::STORE_VALUE);
+    p.add_option("--password")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .default_value("secret");
+    p.exactly_one_of({"json", "yaml"})
+        .at_most_one_of({"quiet", "verbose"})
+        .requires_options("user", {"password"});
+    try {
+      p.eat_arguments(length(argv), argv);
+      FAIL("expected constraint violations");
+    } catch (const optionparser::ParserError &err) {
+      CHECK(std::string(err.what()) ==
+            "Invalid combination of flags: exactly one of --json, --yaml is "
+            "required; at most one of --quiet, --verbose is allowed; --user "
+            "requires --password.");
+    }
+  }
+
+  SUBCASE("group cardinality across many options") {
+    auto p = parser();
+    std::vector<std::string> group;
+    for (int i = 0; i < 300; ++i) {
+      p.add_option("--opt" + std::to_string(i));
+      if (i % 50 == 0) {
+        group.push_back("opt" + std::to_string(i));
+      }
+    }
+    p.at_least(2, group);
+    const char *one[] = {"tests", "--opt100", "--opt101"};
+    CHECK_THROWS_AS(p.eat_arguments(length(one), one),
+                    optionparser::ParserError);
+    const char *two[] = {"tests", "--opt100", "--opt250"};
+    CHECK_NOTHROW(p.eat_arguments(length(two), two));
+  }
+
+  SUBCASE("constraints on unknown options are rejected") {
+    const char *argv[] = {"tests"};
+    auto p = parser();
+    p.add_option("--json");
+    p.exactly_one_of({"json", "xml"});
+    CHECK_THROWS_AS(p.eat_arguments(length(argv), argv), std::runtime_error);
+  }
+}
+
+TEST_CASE("test duplicate flags and dests") {
+  SUBCASE("duplicate flags are rejected on registration") {
+    auto p = parser();
+    p.add_option("--verbose", "-v");
+    CHECK_THROWS_AS(p.add_option("--verbose"), std::runtime_error);
+    CHECK_THROWS_AS(p.add_option("--very", "-v"), std::runtime_error);
+    CHECK_NOTHROW(p.add_option("--very"));
+  }
+
+  SUBCASE("deferred validation reports every conflict at once") {
+    auto p = parser();
+    p.defer_validation();
+    p.add_option("--verbose", "-v");
+    p.add_option("--version", "-v");
+    p.add_option("--threads");
+    p.add_option("-j").dest("threads");
+    p.add_option("--jobs").alias("--version");
+    try {
+      p.validate();
+      FAIL("expected conflicts");
+    } catch (const std::runtime_error &err) {
+      CHECK(std::string(err.what()) ==
+            "Parser inconsistency: flag '-v' is registered twice; dest "
+            "'threads' is used by more than one option; flag '--version' is "
+            "registered twice.");
+    }
+    const char *argv[] = {"tests"};
+    CHECK_THROWS_AS(p.eat_arguments(length(argv), argv), std::runtime_error);
+  }
+}
+
+TEST_CASE("test choices") {
+  enum class Level { Low = 1, High = 10 };
+  SUBCASE("choices map to numbers and enums") {
+    const char *argv[] = {"tests", "--mode", "balanced", "--level", "high",
+                          "low"};
+    auto p = parser();
+    p.add_option("--mode")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .choices({"fast", "safe", "balanced"})
+        .default_value("safe");
+    p.add_option("--level")
+        .mode(optionparser::StorageMode::STORE_MULT_VALUES)
+        .choices<Level>({{"low", Level::Low}, {"high", Level::High}});
+    p.eat_arguments(length(argv), argv);
+    CHECK(p.get_choice("mode") == 2);
+    CHECK(p.get_choice<Level>("level") == Level::High);
+    CHECK(p.get_choices<Level>("level") ==
+          std::vector<Level>{Level::High, Level::Low});
+  }
+
+  SUBCASE("defaults are choices too") {
+    const char *argv[] = {"tests"};
+    auto p = parser();
+    p.add_option("--mode")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .choices({"fast", "safe", "balanced"})
+        .default_value("safe");
+    p.add_option("--level")
+        .mode(optionparser::StorageMode::STORE_MULT_VALUES)
+        .choices<Level>({{"low", Level::Low}, {"high", Level::High}});
+    p.eat_arguments(length(argv), argv);
+    CHECK(p.get_choice("mode") == 1);
+  }
+
+  SUBCASE("invalid values name the closest choices") {
+    const char *argv[] = {"tests", "--mode", "fats"};
+    auto p = parser();
+    p.add_option("--mode")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .choices({"fast", "safe", "balanced"})
+        .default_value("safe");
+    p.add_option("--level")
+        .mode(optionparser::StorageMode::STORE_MULT_VALUES)
+        .choices<Level>({{"low", Level::Low}, {"high", Level::High}});
+    try {
+      p.eat_arguments(length(argv), argv);
+      FAIL("expected an invalid choice");
+    } catch (const optionparser::ParserError &err) {
+      CHECK(std::string(err.what()) ==
+            "error, invalid choice 'fats' for '--mode', closest choices: "
+            "fast, safe, balanced.");
+    }
+  }
+
+  SUBCASE("thousands of choices") {
+    std::vector<std::string> regions;
+    for (int i = 0; i < 5000; ++i) {
+      regions.push_back("region-" + std::to_string(i));
+    }
+    auto p = parser();
+    p.add_option("--region")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .choices(regions);
+    const char *argv[] = {"tests", "--region", "region-4321"};
+    p.eat_arguments(length(argv), argv);
+    CHECK(p.get_choice("region") == 4321);
+    const char *typo[] = {"tests", "--region", "regoin-4321"};
+    try {
+      p.eat_arguments(length(typo), typo);
+      FAIL("expected an invalid choice");
+    } catch (const optionparser::ParserError &err) {
+      CHECK(std::string(err.what()).find("closest choices: region-4321") !=
+            std::string::npos);
+    }
+  }
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+TEST_CASE("test path checks") {
+  SUBCASE("valid paths") {
+    const char *argv[] = {"tests", "--input", __FILE__, "/", "--out", "/"};
+    auto p = parser();
+    p.add_option("--input")
+        .mode(optionparser::StorageMode::STORE_MULT_VALUES)
+        .exists()
+        .readable();
+    p.add_option("--out")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .is_dir();
+    CHECK_NOTHROW(p.eat_arguments(length(argv), argv));
+  }
+
+  SUBCASE("every invalid path is reported") {
+    const char *argv[] = {"tests", "--input", __FILE__, "/no/such/file",
+                          "--out", __FILE__};
+    auto p = parser();
+    p.add_option("--input")
+        .mode(optionparser::StorageMode::STORE_MULT_VALUES)
+        .exists()
+        .readable();
+    p.add_option("--out")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .is_dir();
+    try {
+      p.eat_arguments(length(argv), argv);
+      FAIL("expected invalid paths");
+    } catch (const optionparser::ParserError &err) {
+      CHECK(std::string(err.what()) ==
+            "Invalid paths: --input '/no/such/file' does not exist; --out '" +
+                std::string(__FILE__) + "' is not a directory.");
+    }
+  }
+
+  SUBCASE("defaults are checked") {
+    auto p = parser();
+    p.add_option("--config")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .exists()
+        .default_value("/no/such/config");
+    const char *argv[] = {"tests"};
+    try {
+      p.eat_arguments(length(argv), argv);
+      FAIL("expected an invalid default");
+    } catch (const optionparser::ParserError &err) {
+      CHECK(std::string(err.what()) ==
+            "Invalid paths: --config '/no/such/config' does not exist.");
+    }
+    const char *given[] = {"tests", "--config", __FILE__};
+    CHECK_NOTHROW(p.eat_arguments(length(given), given));
+  }
+
+  SUBCASE("values read as events are checked") {
+    auto p = parser();
+    p.add_option("--input")
+        .mode(optionparser::StorageMode::STORE_MULT_VALUES)
+        .exists();
+    const char *argv[] = {"tests", "--input", __FILE__, "/no/such/file"};
+    std::size_t events = 0;
+    try {
+      for (const auto &event : p.read_arguments(length(argv), argv)) {
+        (void)event;
+        ++events;
+      }
+      FAIL("expected an invalid path");
+    } catch (const optionparser::ParserError &err) {
+      CHECK(std::string(err.what()) ==
+            "Invalid paths: --input '/no/such/file' does not exist.");
+    }
+    CHECK(events == 2);
+  }
+
+  SUBCASE("many paths") {
+    std::vector<std::string> args = {"tests", "--input"};
+    for (int i = 0; i < 1000; ++i) {
+      args.push_back(i == 500 ? "/missing" : "/");
+    }
+    auto p = parser();
+    p.add_option("--input")
+        .mode(optionparser::StorageMode::STORE_MULT_VALUES)
+        .exists()
+        .readable();
+    p.add_option("--out")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .is_dir();
+    CHECK_THROWS_AS(p.eat_arguments(args.begin(), args.end()),
+                    optionparser::ParserError);
+  }
+}
+#endif
+
+#ifndef OPTIONPARSER_NO_HELP
+TEST_CASE("test completion scripts") {
+  auto p = parser();
+  p.prog_name("/usr/bin/tool");
+  p.add_option("--verbose", "-v").help("say more");
+  p.add_option("--mode", "-m")
+      .help("how [fast]")
+      .mode(optionparser::StorageMode::STORE_VALUE)
+      .choices({"fast", "slow", "it's", "very slow"});
+  p.add_option("--config")
+      .help("settings file")
+      .mode(optionparser::StorageMode::STORE_VALUE)
+      .exists();
+  p.add_option("--out")
+      .help("where it's written")
+      .mode(optionparser::StorageMode::STORE_VALUE)
+      .is_dir();
+  p.add_option("--tag").mode(optionparser::StorageMode::STORE_MULT_VALUES);
+  p.add_option("--jobs")
+      .mode(optionparser::StorageMode::STORE_VALUE)
+      .alias("-j")
+      .deprecated_alias("--workers");
+  p.add_option("input");
+
+  SUBCASE("bash") {
+    auto bash = p.completion_script("bash");
+    CHECK(bash.find("_tool_complete() {\n") != std::string::npos);
+    CHECK(bash.find("  local IFS=$'\\n'\n") != std::string::npos);
+    CHECK(bash.find("    --mode|-m)\n"
+                    "      COMPREPLY=($(compgen -W 'fast\nslow\nit\\'\\''s\n"
+                    "very\\ slow' -- \"$cur\"))\n") != std::string::npos);
+    CHECK(bash.find("    --config)\n"
+                    "      COMPREPLY=($(compgen -f -- \"$cur\"))\n") !=
+          std::string::npos);
+    CHECK(bash.find("    --out)\n"
+                    "      COMPREPLY=($(compgen -d -- \"$cur\"))\n") !=
+          std::string::npos);
+    CHECK(bash.find("    --tag)\n      COMPREPLY=()\n") != std::string::npos);
+    CHECK(bash.find("--verbose)") == std::string::npos);
+    CHECK(bash.find("compgen -W '--help\n-h\n--verbose\n-v\n--mode\n-m\n"
+                    "--config\n--out\n--tag\n--jobs\n-j' -- \"$cur\"") !=
+          std::string::npos);
+    CHECK(bash.find("--workers") == std::string::npos);
+    CHECK(bash.find("complete -F _tool_complete tool\n") != std::string::npos);
+  }
+
+  SUBCASE("zsh") {
+    auto zsh = p.completion_script("zsh");
+    CHECK(zsh.find("#compdef tool\n") == 0);
+    CHECK(zsh.find("'(--verbose -v)'{--verbose,-v}'[say more]'") !=
+          std::string::npos);
+    CHECK(zsh.find("'(--mode -m)'{--mode,-m}'[how \\[fast\\]]:MODE:(fast "
+                   "slow it\\'\\''s very\\ slow)'") != std::string::npos);
+    CHECK(zsh.find("'--config[settings file]:CONFIG:_files'") !=
+          std::string::npos);
+    CHECK(zsh.find("'--out[where it'\\''s written]:OUT:_files -/'") !=
+          std::string::npos);
+    CHECK(zsh.find("'*--tag[]:TAG1: '") != std::string::npos);
+    CHECK(zsh.find("':INPUT:_files'") != std::string::npos);
+  }
+
+  SUBCASE("fish") {
+    auto fish = p.completion_script("fish");
+    CHECK(fish.find("complete -c 'tool' -l 'verbose' -s 'v' -d 'say more'\n") !=
+          std::string::npos);
+    CHECK(fish.find("complete -c 'tool' -l 'mode' -s 'm' -d 'how [fast]' -x "
+                    "-a 'fast slow it\\\\\\'s very\\\\ slow'\n") !=
+          std::string::npos);
+    CHECK(fish.find("-l 'config' -d 'settings file' -r -F\n") !=
+          std::string::npos);
+    CHECK(fish.find("-l 'out' -d 'where it\\'s written' -x -a "
+                    "'(__fish_complete_directories)'\n") != std::string::npos);
+    CHECK(fish.find("-l 'tag' -x\n") != std::string::npos);
+    CHECK(fish.find("-l 'jobs' -s 'j' -x\n") != std::string::npos);
+  }
+
+  SUBCASE("subcommands") {
+    auto q = parser();
+    q.prog_name("vcs");
+    q.add_option("--color")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .choices({"auto", "never"});
+    q.add_subcommand(
+        "clone",
+        [](optionparser::OptionParser &clone) {
+          clone.add_option("--depth").mode(
+              optionparser::StorageMode::STORE_VALUE);
+          clone.add_option("--branch")
+              .mode(optionparser::StorageMode::STORE_VALUE)
+              .complete_with([](const std::string &) {
+                return std::vector<std::string>{};
+              });
+        },
+        "copy a repository");
+    q.add_subcommand("pull", [](optionparser::OptionParser &pull) {
+      pull.add_option("--rebase");
+    });
+
+    auto bash = q.completion_script("bash");
+    CHECK(bash.find("    case \"${COMP_WORDS[i]}\" in\n"
+                    "      clone|pull)\n"
+                    "        command=\"${COMP_WORDS[i]}\"\n") !=
+          std::string::npos);
+    CHECK(bash.find("    clone)\n"
+                    "      case \"$prev\" in\n"
+                    "        --depth)\n"
+                    "          COMPREPLY=()\n") != std::string::npos);
+    CHECK(bash.find("COMPREPLY=($(compgen -W '--help\n-h\n--rebase' -- "
+                    "\"$cur\"))") != std::string::npos);
+    CHECK(bash.find("    *)\n"
+                    "      case \"$prev\" in\n"
+                    "        --color)\n") != std::string::npos);
+    CHECK(bash.find("        COMPREPLY=($(compgen -W 'clone\npull' -- "
+                    "\"$cur\"))") != std::string::npos);
+
+    auto zsh = q.completion_script("zsh");
+    CHECK(zsh.find("_arguments -s -C \\\n") != std::string::npos);
+    CHECK(zsh.find("'1:command:(clone pull)' \\\n"
+                   "  '*::argument:->cmds' && return\n") !=
+          std::string::npos);
+    CHECK(zsh.find("      clone)\n"
+                   "        _arguments -s \\\n") != std::string::npos);
+    CHECK(zsh.find("          '--depth[]:DEPTH: '") != std::string::npos);
+    CHECK(zsh.find("'--branch[]:BRANCH:{compadd -- ${(f)\"$($all_words[1] "
+                   "--__complete $((CURRENT-1+$#all_words-$#words)) "
+                   "\"${all_words[@]}\" 2>/dev/null)\"}}'") !=
+          std::string::npos);
+    CHECK(zsh.find("          '--rebase[]'\n") != std::string::npos);
+
+    auto fish = q.completion_script("fish");
+    CHECK(fish.find("function __vcs_complete\n") == fish.find('\n') + 1);
+    CHECK(fish.find("complete -c 'vcs' -n '__fish_use_subcommand' -f -a "
+                    "'clone' -d 'copy a repository'\n") != std::string::npos);
+    CHECK(fish.find("complete -c 'vcs' -n '__fish_use_subcommand' -l 'color' "
+                    "-x -a 'auto never'\n") != std::string::npos);
+    CHECK(fish.find("complete -c 'vcs' -n '__fish_seen_subcommand_from "
+                    "clone' -l 'branch' -x -a '(__vcs_complete)'\n") !=
+          std::string::npos);
+    CHECK(fish.find("complete -c 'vcs' -n '__fish_seen_subcommand_from pull' "
+                    "-l 'rebase'\n") != std::string::npos);
+  }
+
+  SUBCASE("values completed by the program") {
+    p.add_option("--host")
+        .mode(optionparser::StorageMode::STORE_VALUE)
+        .complete_with([](const std::string &) {
+          return std::vector<std::string>{};
+        });
+    CHECK(p.completion_script("bash").find(
+              "    --host)\n"
+              "      COMPREPLY=($(\"${COMP_WORDS[0]}\" --__complete "
+              "\"$COMP_CWORD\" \"${COMP_WORDS[@]}\" 2>/dev/null))\n") !=
+          std::string::npos);
+    CHECK(p.completion_script("zsh").find(
+              "'--host[]:HOST:{compadd -- ${(f)\"$($words[1] --__complete "
+              "$((CURRENT-1)) \"${words[@]}\" 2>/dev/null)\"}}'") !=
+          std::string::npos);
+    auto fish = p.completion_script("fish");
+    CHECK(fish.find("function __tool_complete\n") == fish.find('\n') + 1);
+    CHECK(fish.find("-l 'host' -x -a '(__tool_complete)'\n") !=
+          std::string::npos);
+  }
+
+  CHECK_THROWS_AS(p.completion_script("tcsh"), std::invalid_argument);
+}
+#endif // OPTIONPARSER_NO_HELP
+
+TEST_CASE("test completion queries") {
+  std::vector<std::string> prefixes;
+  auto p = parser();
+  p.add_option("--verbose", "-v");
+  p.add_option("--mode", "-m")
+      .mode(optionparser::StorageMode::STORE_VALUE)
+      .choices({"fast", "slow", "safe"});
+  p.add_option("--host")
+      .mode(optionparser::StorageMode::STORE_VALUE)
+      .required(true)
+      .complete_with([&prefixes](const std::string &prefix) {
+        prefixes.push_back(prefix);
+        return std::vector<std::string>{"alpha", "beta", "alpine"};
+      });
+  p.add_option("--tag")
+      .mode(optionparser::StorageMode::STORE_MULT_VALUES)
+      .choices({"x", "y"});
+  p.add_option("--threads").mode(optionparser::StorageMode::STORE_VALUE);
+  p.add_option("--jobs").alias("-j").deprecated_alias("--workers");
+  p.add_option("input").choices({"in.txt", "in.csv"});
+  using V = std::vector<std::string>;
+
+  SUBCASE("flags") {
+    CHECK(p.complete({"tool", "--v"}, 1) == V{"--verbose"});
+    CHECK(p.complete({"tool", "--"}, 1) ==
+          V{"--help", "--verbose", "--mode", "--host", "--tag", "--threads",
+            "--jobs"});
+    CHECK(p.complete({"tool", "-"}, 1) ==
+          V{"--help", "-h", "--verbose", "-v", "--mode", "-m", "--host",
+            "--tag", "--threads", "--jobs", "-j"});
+    CHECK(p.complete({"tool", "--w"}, 1) == V{});
+  }
+
+  SUBCASE("values of the option being completed") {
+    CHECK(p.complete({"tool", "--mode", ""}, 2) == V{"fast", "slow", "safe"});
+    CHECK(p.complete({"tool", "--mode", "s"}, 2) == V{"slow", "safe"});
+    // The word being completed may not have been typed at all yet.
+    CHECK(p.complete({"tool", "--mode"}, 2) == V{"fast", "slow", "safe"});
+    CHECK(p.complete({"tool", "--mode", "f", "--verbose"}, 2) == V{"fast"});
+    CHECK(p.complete({"tool", "--mode=f"}, 1) == V{"--mode=fast"});
+    CHECK(p.complete({"tool", "--mo", "sa"}, 2) == V{"safe"});
+    CHECK(p.complete({"tool", "-vm", ""}, 2) == V{"fast", "slow", "safe"});
+    CHECK(p.complete({"tool", "-m", "fast", "--tag", "x", ""}, 5) ==
+          V{"x", "y"});
+    CHECK(p.complete({"tool", "--threads", ""}, 2) == V{});
+  }
+
+  SUBCASE("completers") {
+    CHECK(p.complete({"tool", "--host", "al"}, 2) == V{"alpha", "alpine"});
+    CHECK(p.complete({"tool", "--host=b"}, 1) == V{"--host=beta"});
+    CHECK(prefixes == V{"al", "b"});
+  }
+
+  SUBCASE("positionals") {
+    CHECK(p.complete({"tool", "--mode", "fast", "in"}, 3) ==
+          V{"in.txt", "in.csv"});
+    CHECK(p.complete({"tool", "in.txt", ""}, 2) == V{});
+    CHECK(p.complete({"tool", "--", "-"}, 2) == V{});
+  }
+
+  SUBCASE("nothing is parsed") {
+    // Neither the missing required --host nor the malformed --threads are
+    // reported, and earlier results are left alone.
+    const char *argv[] = {"tests", "--host", "h", "--threads", "4"};
+    p.eat_arguments(length(argv), argv);
+    CHECK(p.complete({"tool", "--threads", "many", "--mode", ""}, 4) ==
+          V{"fast", "slow", "safe"});
+    CHECK(p.get_value<int>("threads") == 4);
+  }
+
+  SUBCASE("only main's arguments ask for completions") {
+    auto q = parser();
+    q.add_option("--verbose");
+    CHECK_THROWS_AS(q.parse_command_line("run --__complete 1 --"),
+                    optionparser::ParserError);
+    CHECK_THROWS_AS(
+        q.eat_arguments(std::vector<std::string>{"child", "--__complete", "x"}),
+        optionparser::ParserError);
+    // Parsers that throw never exit, not even to answer completions.
+    const char *argv[] = {"tests", "--__complete", "1", "tests"};
+    CHECK_THROWS_AS(q.eat_arguments(length(argv), argv),
+                    optionparser::ParserError);
+  }
+
+  SUBCASE("subcommands") {
+    auto q = parser();
+    q.add_option("--verbose");
+    q.add_subcommand("clone", [](optionparser::OptionParser &sub) {
+      sub.add_option("--branch")
+          .mode(optionparser::StorageMode::STORE_VALUE)
+          .choices({"main", "dev"});
+    });
+    q.add_subcommand("commit", [](optionparser::OptionParser &) {});
+    CHECK(q.complete({"vcs", "c"}, 1) == V{"clone", "commit"});
+    CHECK(q.complete({"vcs", "--verbose", "cl"}, 2) == V{"clone"});
+    CHECK(q.complete({"vcs", "clone", "--b"}, 2) == V{"--branch"});
+    CHECK(q.complete({"vcs", "clone", "--branch", "d"}, 3) == V{"dev"});
+  }
+}
+
+#ifdef OPTIONPARSER_NO_HELP
+TEST_CASE("test --help without help text") {
+  auto p = parser();
+  p.add_subcommand("build", [](optionparser::OptionParser &) {},
+                   "Build a target");
+  const char *argv[] = {"tests", "--help"};
+  CHECK_THROWS_AS(p.eat_arguments(length(argv), argv),
+                  optionparser::ParserError);
+  const char *sub[] = {"tests", "build", "-h"};
+  CHECK_THROWS_AS(p.eat_arguments(length(sub), sub),
+                  optionparser::ParserError);
+}
+#endif
+
+TEST_CASE("test option setters change the schema revision") {
+  auto p = parser();
+  auto &option = p.add_option("--level");
+  auto changes = [&option](std::function<void()> set) {
+    auto before = option.revision();
+    set();
+    return option.revision() != before;
+  };
+  CHECK(changes([&] { option.separator(','); }));
+  CHECK(changes([&] { option.exists(); }));
+  CHECK(changes([&] { option.choices({"low", "high"}); }));
+  CHECK(changes([&] {
+    option.complete_with(
+        [](const std::string &) { return std::vector<std::string>{}; });
+  }));
+  CHECK(changes([&] { option.default_value("low"); }));
+  CHECK(changes([&] { option.default_value(3); }));
+  CHECK(changes([&] { option.default_from([] { return 4; }); }));
+}